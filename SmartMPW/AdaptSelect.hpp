@@ -6,6 +6,8 @@
 #define SMARTMPW_ADAPTSELECT_HPP
 
 #include <future>
+#include <chrono>
+#include <atomic>
 
 #include "Instance.hpp"
 #include "MpwBinPack.hpp"
@@ -14,11 +16,12 @@ using namespace mbp;
 
 class AdaptSelect {
 
-	/// ѡȶ
+	/// 候选宽度定义
+	template<typename Coord>
 	struct CandidateWidth {
 		coord_t value;
 		int iter;
-		unique_ptr<MpwBinPack> mbp_solver; // ָ룬ɵĿ
+		unique_ptr<MpwBinPack<Coord>> mbp_solver; // 存指针，减少排序造成的开销
 	};
 
 public:
@@ -27,55 +30,65 @@ public:
 
 	AdaptSelect(const Environment &env, const Config &cfg) :
 		_env(env), _cfg(cfg), _ins(env), _gen(_cfg.random_seed),
-		_obj_area(numeric_limits<coord_t>::max()) {}
+		_obj_area(numeric_limits<coord_t>::max()), _incumbent_area(numeric_limits<coord_t>::max()) {}
 
 	void run() {
-
-		_start = clock();
-
 		//vector<coord_t> candidate_widths = cal_candidate_widths_on_interval();
 		vector<coord_t> candidate_widths = cal_candidate_widths_on_sqrt();
-		vector<CandidateWidth> cw_objs; cw_objs.reserve(candidate_widths.size());
+		// 坐标上界连同最大的候选宽度都能放进compact_coord_t时用紧凑坐标的求解器，两者的解相同
+		if (_ins.fits_compact_coord(candidate_widths.back())) { run_with<compact_coord_t>(candidate_widths, compact_catalog_t(_ins.get_catalog())); }
+		else { run_with<coord_t>(candidate_widths, _ins.get_catalog()); }
+	}
+
+private:
+	template<typename Coord>
+	void run_with(const vector<coord_t> &candidate_widths, const typename MpwBinPack<Coord>::catalog_t &catalog) {
+
+		_start = chrono::steady_clock::now();
 
-		// ֧ʼiter=1
-		// ߳
+		vector<CandidateWidth<Coord>> cw_objs; cw_objs.reserve(candidate_widths.size());
+		utils::ThreadPool pool(_cfg.worker_num);
+
+		// 分支初始化iter=1
+		// 在主线程中按顺序构造并分配种子，各宽度的首轮RLS在工作线程上并行执行
 		for (coord_t bin_width : candidate_widths) {
-			cw_objs.push_back({ bin_width, 1, unique_ptr<MpwBinPack>(
-				new MpwBinPack(_ins.get_polygon_ptrs(), bin_width, INF, _gen)) });
-			cout << " width " << bin_width << endl;
-			cw_objs.back().mbp_solver->random_local_search(1);
-			cout << cw_objs.back().mbp_solver->get_skyline_height()*bin_width << endl;
-			check_cwobj(cw_objs.back());
+			cw_objs.push_back({ bin_width, 1, unique_ptr<MpwBinPack<Coord>>(
+				new MpwBinPack<Coord>(_ins.get_polygon_ptrs(), catalog, bin_width, INF, _gen())) });
+			cw_objs.back().mbp_solver->set_incumbent(&_incumbent_area);
+			cw_objs.back().mbp_solver->set_thread_pool(&pool); // 批量RLS在同一个池上解码邻域
+		}
+		pool.parallel_for(cw_objs.size(), [&](size_t i, int) { cw_objs[i].mbp_solver->random_local_search(1); });
+		for (auto &cw_obj : cw_objs) {
+			cout << " width " << cw_obj.value << endl;
+			cout << cw_obj.mbp_solver->get_obj_area() << endl;
+			check_cwobj(cw_obj);
 		}
-		// ߳ ==> async
-		//vector<future<void>> futures; futures.reserve(candidate_widths.size());
-		//for (coord_t bin_width : candidate_widths) {
-		//	cw_objs.push_back({ bin_width, 1, unique_ptr<MpwBinPack>(
-		//		new MpwBinPack(_ins.get_polygon_ptrs(), bin_width, INF, _gen)) });
-		//	futures.push_back(async(&MpwBinPack::random_local_search, cw_objs.back().mbp_solver.get(), 1));
-		//	//futures.push_back(async([&]() { cw_objs.back().mbp_solver->random_local_search(1); }));
-		//}
-		//for (auto &f : futures) { f.wait(); }
-		//for (auto &cw_obj : cw_objs) { check_cwobj(cw_obj); }
 
-		// УԽѡиԽ
-		sort(cw_objs.begin(), cw_objs.end(), [](const CandidateWidth &lhs, const CandidateWidth &rhs) {
+		// 降序排列，越后面的选中概率越大
+		sort(cw_objs.begin(), cw_objs.end(), [](const CandidateWidth<Coord> &lhs, const CandidateWidth<Coord> &rhs) {
 			return lhs.mbp_solver->get_obj_area() > rhs.mbp_solver->get_obj_area(); });
 
-		// ʼɢʷֲ
+		// 初始化离散概率分布
 		vector<int> probs; probs.reserve(cw_objs.size());
 		for (int i = 1; i <= cw_objs.size(); ++i) { probs.push_back(2 * i); }
 		discrete_distribution<> discrete_dist(probs.begin(), probs.end());
 
-		// Ż
+		// 迭代优化，每轮挑选至多pool.size()个不同的宽度，在工作线程上并行RLS
 		int curr_iter = 0; _iteration = 0;
-		while (static_cast<double>(clock() - _start) / CLOCKS_PER_SEC < _cfg.ub_asa_time) {
+		vector<CandidateWidth<Coord> *> picked_widths; picked_widths.reserve(pool.size());
+		while (elapsed_seconds() < _cfg.ub_asa_time) {
 			//&& curr_iter - _iteration < _cfg.ub_asa_iter) {
-			CandidateWidth &picked_width = cw_objs[discrete_dist(_gen)];
-			picked_width.iter = min(2 * picked_width.iter, _cfg.ub_rls_iter);
-			picked_width.mbp_solver->set_bin_height(coord_t(floor(1.0 * _obj_area / picked_width.value)));
-			picked_width.mbp_solver->random_local_search(picked_width.iter);
-			check_cwobj(picked_width, ++curr_iter);
+			picked_widths.clear();
+			for (int i = 0; i < pool.size(); ++i) {
+				CandidateWidth<Coord> *picked_width = &cw_objs[discrete_dist(_gen)];
+				if (find(picked_widths.begin(), picked_widths.end(), picked_width) != picked_widths.end()) { continue; }
+				picked_width->iter = min(2 * picked_width->iter, _cfg.ub_rls_iter);
+				picked_width->mbp_solver->set_bin_height(coord_t(floor(1.0 * _incumbent_area / picked_width->value)));
+				picked_widths.push_back(picked_width);
+			}
+			pool.parallel_for(picked_widths.size(), [&](size_t i, int) {
+				picked_widths[i]->mbp_solver->random_local_search(picked_widths[i]->iter); });
+			for (CandidateWidth<Coord> *picked_width : picked_widths) { check_cwobj(*picked_width, ++curr_iter); }
 			/*for (auto& dst_node : _dst) {
 				cout << "In Polygon:" << endl;
 				for (auto& point : *dst_node->in_points) { cout << "(" << point.x << "," << point.y << ")"; }
@@ -85,30 +98,52 @@ public:
 					[&](point_t& point) { cout << "(" << point.x << "," << point.y << ")"; });
 				cout << endl;
 			}*/
-			sort(cw_objs.begin(), cw_objs.end(), [](const CandidateWidth &lhs, const CandidateWidth &rhs) {
+			sort(cw_objs.begin(), cw_objs.end(), [](const CandidateWidth<Coord> &lhs, const CandidateWidth<Coord> &rhs) {
 				return lhs.mbp_solver->get_obj_area() > rhs.mbp_solver->get_obj_area(); });
 		}
+
+		// 重复的sequence由visited过滤器跳过，不再解码
+		size_t visited_probes = 0, visited_hits = 0, visited_resets = 0;
+		for (auto &cw_obj : cw_objs) {
+			visited_probes += cw_obj.mbp_solver->get_visited_probes();
+			visited_hits += cw_obj.mbp_solver->get_visited_hits();
+			visited_resets += cw_obj.mbp_solver->get_visited_resets();
+		}
+		cout << "revisited: " << visited_hits << "/" << visited_probes << ", filter resets: " << visited_resets << endl;
+
+		// 不影响任何一步选择的交换不必解码
+		size_t noop_moves = 0, evaluated_moves = 0;
+		for (auto &cw_obj : cw_objs) {
+			noop_moves += cw_obj.mbp_solver->get_noop_moves();
+			evaluated_moves += cw_obj.mbp_solver->get_evaluated_moves();
+		}
+		cout << "skipped moves: " << noop_moves << ", evaluated moves: " << evaluated_moves << endl;
 	}
 
-	void record_sol(const string &sol_path) const {
+public:
+	void record_sol(const string& sol_path) const {
 		ofstream sol_file(sol_path);
-		for (auto &dst_node : _dst) {
+		vector<point_t> out_points;
+		for (auto& placement : _dst) {
+			const polygon_ptr& src_node = _ins.get_polygon_ptrs()[placement.id];
 			sol_file << "In Polygon:" << endl;
-			for (auto &point : *dst_node->in_points) { sol_file << "(" << point.x << "," << point.y << ")"; }
-			dst_node->to_out_points();
+			for (auto& point : *src_node->in_points) { sol_file << "(" << point.x << "," << point.y << ")"; }
+			src_node->to_out_points(placement.lb_point(), static_cast<Rotation>(placement.rotation), out_points);
 			sol_file << endl << "Out Polygon:" << endl;
-			for_each(dst_node->out_points.begin(), dst_node->out_points.end(),
-				[&](point_t &point) { sol_file << "(" << point.x << "," << point.y << ")"; });
+			for_each(out_points.begin(), out_points.end(),
+				[&](point_t& point) { sol_file << "(" << point.x << "," << point.y << ")"; });
 			sol_file << endl;
 		}
 	}
 
-	void draw_sol(const string &html_path) const {
+	void draw_sol(const string& html_path) const {
 		utils_visualize_drawer::Drawer html_drawer(html_path, _cfg.ub_width, _cfg.ub_height);
-		for (auto &dst_node : _dst) {
+		vector<point_t> out_points;
+		for (auto& placement : _dst) {
+			_ins.get_polygon_ptrs()[placement.id]->to_out_points(placement.lb_point(), static_cast<Rotation>(placement.rotation), out_points);
 			string polygon_str;
-			for_each(dst_node->out_points.begin(), dst_node->out_points.end(),
-				[&](point_t &point) { polygon_str += to_string(point.x*0.01) + "," + to_string(point.y*0.01) + " "; });
+			for_each(out_points.begin(), out_points.end(),
+				[&](point_t& point) { polygon_str += to_string(point.x*0.01) + "," + to_string(point.y*0.01) + " "; });
 			html_drawer.polygon(polygon_str);
 		}
 	}
@@ -139,12 +174,12 @@ public:
 			<< _ins.get_total_area() << "," << _obj_area << "," << _fill_ratio << ","
 			<< _width << "," << _height << "," << _wh_ratio << ","
 			<< _iteration << "," << _duration << ","
-			<< static_cast<double>(clock() - _start) / CLOCKS_PER_SEC << "," << _cfg.random_seed << endl;
+			<< elapsed_seconds() << "," << _cfg.random_seed << endl;
 	}
 #endif // !SUBMIT
 
 private:
-	/// [lb_width, ub_width]ڣȾɺѡ
+	/// 在区间[lb_width, ub_width]内，等距地生成候选宽度
 	vector<coord_t> cal_candidate_widths_on_interval(coord_t interval = 1) {
 		vector<coord_t> candidate_widths;
 		coord_t min_width = 0, max_width = 0;
@@ -163,7 +198,7 @@ private:
 		return candidate_widths;
 	}
 
-	/// ƽƳȣ֧Ŀ
+	/// 开平方限制长宽比，削减分支数目
 	vector<coord_t> cal_candidate_widths_on_sqrt(coord_t interval = 1) {
 		vector<coord_t> candidate_widths;
 		coord_t min_width = floor(_cfg.lb_scale * sqrt(_ins.get_total_area()));
@@ -180,13 +215,17 @@ private:
 		return candidate_widths;
 	}
 
-	/// cw_objRLS
-	void check_cwobj(const CandidateWidth &cw_obj, int curr_iter = 0) {
+	/// 自_start起经过的墙上时间，多线程下clock()会累计各线程的CPU时间
+	double elapsed_seconds() const { return chrono::duration<double>(chrono::steady_clock::now() - _start).count(); }
+
+	/// 检查cw_obj的RLS结果
+	template<typename Coord>
+	void check_cwobj(const CandidateWidth<Coord> &cw_obj, int curr_iter = 0) {
 		coord_t cw_height = cw_obj.mbp_solver->get_obj_area() / cw_obj.value;
-		//if (cw_height > _cfg.ub_height) { // ߶ȳϽ磬Ϸ
+		//if (cw_height > _cfg.ub_height) { // 解高度超出上界，不合法
 		//	cw_obj.mbp_solver->set_obj_area(numeric_limits<coord_t>::max());
 		//}
-		//if (cw_height < _cfg.lb_height) { // ߶Ȳ½磬½
+		//if (cw_height < _cfg.lb_height) { // 解高度不足下界，按下界计算
 		//	cw_obj.mbp_solver->set_obj_area(cw_obj.value * _cfg.lb_height);
 		//}
 		if (cw_obj.mbp_solver->get_obj_area() < _obj_area) {
@@ -195,7 +234,8 @@ private:
 			_width = cw_obj.value;
 			_height = cw_height;
 			_wh_ratio = 1.0 * max(_width, _height) / min(_width, _height);
-			_dst = cw_obj.mbp_solver->get_dst();
+			auto &dst = cw_obj.mbp_solver->get_dst();
+			_dst = vector<placement_t>(dst.begin(), dst.end()); // 紧凑坐标的放置记录在这里转换回coord_t
 			/*for (auto& dst_node : _dst) {
 				cout << "In Polygon:" << endl;
 				for (auto& point : *dst_node->in_points) { cout << "(" << point.x << "," << point.y << ")"; }
@@ -205,7 +245,7 @@ private:
 					[&](point_t& point) { cout << "(" << point.x << "," << point.y << ")"; });
 				cout << endl;
 			}*/
-			_duration = static_cast<double>(clock() - _start) / CLOCKS_PER_SEC;
+			_duration = elapsed_seconds();
 			_iteration = curr_iter;
 		}
 	}
@@ -216,16 +256,17 @@ private:
 
 	const Instance _ins;
 	default_random_engine _gen;
-	clock_t _start;
-	double _duration; // Žʱ
-	int _iteration;   // Žֵ
+	chrono::steady_clock::time_point _start;
+	double _duration; // 最优解出现时间
+	int _iteration;   // 最优解出现迭代次数
 
 	coord_t _obj_area;
+	atomic<coord_t> _incumbent_area; // 各宽度的RLS共享的最优面积，用于收紧高度上界
 	double _fill_ratio;
 	coord_t _width;
 	coord_t _height;
 	double _wh_ratio;
-	vector<polygon_ptr> _dst;
+	vector<placement_t> _dst;
 };
 
 #endif // SMARTMPW_ADAPTSELECT_HPP
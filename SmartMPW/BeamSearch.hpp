@@ -1,6 +1,7 @@
 #ifndef SMARTMPW_BEAMSEARCH_HPP
 #define SMARTMPW_BEAMSEARCH_HPP
 
+#include <chrono>
 
 #include "Instance.hpp"
 #include "MpwBinPack.hpp"
@@ -10,12 +11,13 @@ using namespace mbp;
 
 class BeamSearch 
 {
-	/// ѡȶ
+	/// 候选宽度定义
+	template<typename Coord>
 	struct CandidateWidth 
 	{
 		coord_t value;
 		int iter;
-		unique_ptr<MpwBinPack> mbp_solver; // ָ룬ɵĿ
+		unique_ptr<MpwBinPack<Coord>> mbp_solver; // 存指针，减少排序造成的开销
 	};
 
 
@@ -29,31 +31,55 @@ public:
 
 	void run()
 	{
-		_start = clock();
+		//vector<coord_t> candidate_widths = cal_candidate_widths_on_interval();
+		vector<coord_t> candidate_widths = cal_candidate_widths_on_sqrt();
+		// 坐标上界连同最大的候选宽度都能放进compact_coord_t时用紧凑坐标的求解器，两者的解相同
+		if (_ins.fits_compact_coord(candidate_widths.back())) { run_with<compact_coord_t>(candidate_widths, compact_catalog_t(_ins.get_catalog())); }
+		else { run_with<coord_t>(candidate_widths, _ins.get_catalog()); }
+	}
+
+private:
+	template<typename Coord>
+	void run_with(const vector<coord_t> &candidate_widths, const typename MpwBinPack<Coord>::catalog_t &catalog)
+	{
+		_start = chrono::steady_clock::now();
 
 		int total = _ins.get_total_area();
 		cout << "total: " << total << endl;
-		//vector<coord_t> candidate_widths = cal_candidate_widths_on_interval();
-		vector<coord_t> candidate_widths = cal_candidate_widths_on_sqrt();
-		vector<CandidateWidth> cw_objs; cw_objs.reserve(candidate_widths.size());
-		int best = -1;
-		int best_width = 0;
+		vector<CandidateWidth<Coord>> cw_objs; cw_objs.reserve(candidate_widths.size());
+		// 在主线程中按宽度顺序构造并分配种子，_gen的消耗顺序与线程数无关
 		for (coord_t bin_width : candidate_widths) {
+			cw_objs.push_back({ bin_width, 1, unique_ptr<MpwBinPack<Coord>>(
+				new MpwBinPack<Coord>(_ins.get_polygon_ptrs(), catalog, bin_width, INF, _gen())) });
+		}
 
-			cw_objs.push_back({ bin_width, 1, unique_ptr<MpwBinPack>(
-				new MpwBinPack(_ins.get_polygon_ptrs(), bin_width, INF, _gen)) });
-			//cout << " width " << bin_width << endl;
-			int res = cw_objs.back().mbp_solver->mbp_based_beamsearch();
-			//cout << height << endl; //ÿһbeamsearchһ⣬µ
-			if (best == -1 || best > res)
+		// 各宽度相互独立，交给线程池并行求解；宽度内部的子代扩展和rollout嵌套使用同一线程池
+		vector<int> results(cw_objs.size());
+		vector<double> durations(cw_objs.size());
+		utils::ThreadPool pool(_cfg.worker_num);
+		for (auto &cw_obj : cw_objs) { cw_obj.mbp_solver->set_thread_pool(&pool); }
+		pool.parallel_for(cw_objs.size(), [&](size_t i, int) {
+			auto width_start = chrono::steady_clock::now();
+			results[i] = cw_objs[i].mbp_solver->mbp_based_beamsearch();
+			durations[i] = chrono::duration<double>(chrono::steady_clock::now() - width_start).count();
+		});
+
+		// 按宽度顺序归约，best和best_width与线程数无关
+		int best = -1;
+		int best_width = 0;
+		for (size_t i = 0; i < cw_objs.size(); ++i) {
+			const MpwBinPack<Coord> &solver = *cw_objs[i].mbp_solver;
+			cout << " width " << cw_objs[i].value << " area " << results[i] << " time " << durations[i] << "s"
+				<< " tt hit " << solver.get_tt_hits() << "/" << solver.get_tt_probes()
+				<< " shared " << solver.get_shared_rollouts() << endl;
+			if (best == -1 || best > results[i])
 			{
-				best = res;
-				best_width = bin_width;
+				best = results[i];
+				best_width = cw_objs[i].value;
 			}
+			check_cwobj(cw_objs[i]);
 		}
-		clock_t _end = clock();
-		double sec = (double)(_end - _start) / CLOCKS_PER_SEC;
-		cout << sec << endl;
+		cout << elapsed_seconds() << endl;
 		cout << "best: " << best << endl;
 		cout << "fill ratio: " << (double)total / best << endl;
 		int height = best / best_width;
@@ -62,14 +88,17 @@ public:
 	}
 
 
+public:
 	void record_sol(const string& sol_path) const {
 		ofstream sol_file(sol_path);
-		for (auto& dst_node : _dst) {
+		vector<point_t> out_points;
+		for (auto& placement : _dst) {
+			const polygon_ptr& src_node = _ins.get_polygon_ptrs()[placement.id];
 			sol_file << "In Polygon:" << endl;
-			for (auto& point : *dst_node->in_points) { sol_file << "(" << point.x << "," << point.y << ")"; }
-			dst_node->to_out_points();
+			for (auto& point : *src_node->in_points) { sol_file << "(" << point.x << "," << point.y << ")"; }
+			src_node->to_out_points(placement.lb_point(), static_cast<Rotation>(placement.rotation), out_points);
 			sol_file << endl << "Out Polygon:" << endl;
-			for_each(dst_node->out_points.begin(), dst_node->out_points.end(),
+			for_each(out_points.begin(), out_points.end(),
 				[&](point_t& point) { sol_file << "(" << point.x << "," << point.y << ")"; });
 			sol_file << endl;
 		}
@@ -77,9 +106,11 @@ public:
 
 	void draw_sol(const string& html_path) const {
 		utils_visualize_drawer::Drawer html_drawer(html_path, _cfg.ub_width, _cfg.ub_height);
-		for (auto& dst_node : _dst) {
+		vector<point_t> out_points;
+		for (auto& placement : _dst) {
+			_ins.get_polygon_ptrs()[placement.id]->to_out_points(placement.lb_point(), static_cast<Rotation>(placement.rotation), out_points);
 			string polygon_str;
-			for_each(dst_node->out_points.begin(), dst_node->out_points.end(),
+			for_each(out_points.begin(), out_points.end(),
 				[&](point_t& point) { polygon_str += to_string(point.x * 0.01) + "," + to_string(point.y * 0.01) + " "; });
 			html_drawer.polygon(polygon_str);
 		}
@@ -111,14 +142,14 @@ public:
 			<< _ins.get_total_area() << "," << _obj_area << "," << _fill_ratio << ","
 			<< _width << "," << _height << "," << _wh_ratio << ","
 			<< _iteration << "," << _duration << ","
-			<< static_cast<double>(clock() - _start) / CLOCKS_PER_SEC << "," << _cfg.random_seed << endl;
+			<< elapsed_seconds() << "," << _cfg.random_seed << endl;
 	}
 #endif // !SUBMIT
 
 
 
 private:
-	/// [lb_width, ub_width]ڣȾɺѡ
+	/// 在区间[lb_width, ub_width]内，等距地生成候选宽度
 	vector<coord_t> cal_candidate_widths_on_interval(coord_t interval = 1) {
 		vector<coord_t> candidate_widths;
 		coord_t min_width = 0, max_width = 0;
@@ -137,7 +168,7 @@ private:
 		return candidate_widths;
 	}
 
-	/// ƽƳȣ֧Ŀ
+	/// 开平方限制长宽比，削减分支数目
 	vector<coord_t> cal_candidate_widths_on_sqrt(coord_t interval = 1) {
 		vector<coord_t> candidate_widths;
 		coord_t min_width = floor(_cfg.lb_scale * sqrt(_ins.get_total_area()));
@@ -153,13 +184,17 @@ private:
 		return candidate_widths;
 	}
 
-	/// cw_objRLS
-	void check_cwobj(const CandidateWidth& cw_obj, int curr_iter = 0) {
+	/// 自_start起经过的墙上时间，多线程下clock()会累计各线程的CPU时间
+	double elapsed_seconds() const { return chrono::duration<double>(chrono::steady_clock::now() - _start).count(); }
+
+	/// 检查cw_obj的RLS结果
+	template<typename Coord>
+	void check_cwobj(const CandidateWidth<Coord>& cw_obj, int curr_iter = 0) {
 		coord_t cw_height = cw_obj.mbp_solver->get_obj_area() / cw_obj.value;
-		//if (cw_height > _cfg.ub_height) { // ߶ȳϽ磬Ϸ
+		//if (cw_height > _cfg.ub_height) { // 解高度超出上界，不合法
 		//	cw_obj.mbp_solver->set_obj_area(numeric_limits<coord_t>::max());
 		//}
-		//if (cw_height < _cfg.lb_height) { // ߶Ȳ½磬½
+		//if (cw_height < _cfg.lb_height) { // 解高度不足下界，按下界计算
 		//	cw_obj.mbp_solver->set_obj_area(cw_obj.value * _cfg.lb_height);
 		//}
 		if (cw_obj.mbp_solver->get_obj_area() < _obj_area) {
@@ -168,7 +203,8 @@ private:
 			_width = cw_obj.value;
 			_height = cw_height;
 			_wh_ratio = 1.0 * max(_width, _height) / min(_width, _height);
-			_dst = cw_obj.mbp_solver->get_dst();
+			auto &dst = cw_obj.mbp_solver->get_dst();
+			_dst = vector<placement_t>(dst.begin(), dst.end()); // 紧凑坐标的放置记录在这里转换回coord_t
 			/*for (auto& dst_node : _dst) {
 				cout << "In Polygon:" << endl;
 				for (auto& point : *dst_node->in_points) { cout << "(" << point.x << "," << point.y << ")"; }
@@ -178,7 +214,7 @@ private:
 					[&](point_t& point) { cout << "(" << point.x << "," << point.y << ")"; });
 				cout << endl;
 			}*/
-			_duration = static_cast<double>(clock() - _start) / CLOCKS_PER_SEC;
+			_duration = elapsed_seconds();
 			_iteration = curr_iter;
 		}
 	}
@@ -191,16 +227,16 @@ private:
 
 	const Instance _ins;
 	default_random_engine _gen;
-	clock_t _start;
-	double _duration; // Žʱ
-	int _iteration;   // Žֵ
+	chrono::steady_clock::time_point _start;
+	double _duration; // 最优解出现时间
+	int _iteration;   // 最优解出现迭代次数
 
 	coord_t _obj_area;
 	double _fill_ratio;
 	coord_t _width;
 	coord_t _height;
 	double _wh_ratio;
-	vector<polygon_ptr> _dst;
+	vector<placement_t> _dst;
 };
 
 
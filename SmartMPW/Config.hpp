@@ -12,9 +12,12 @@
 #endif // !NDEBUG
 
 #include <random>
+#include <cstdint>
 
 using coord_t = int;
 
+using compact_coord_t = int16_t;  // 算例的坐标上界不超过int16时skyline和放置记录用它存放
+
 static constexpr int INF = 0x3f3f3f3f;
 
 static const char* ins_list[]{
@@ -37,14 +40,17 @@ struct Config {
 	//unsigned int random_seed = std::random_device{}();
 	//unsigned int random_seed = 1196562269;
 	unsigned int random_seed = 10101;
-	int ub_rls_iter = 9999;  // RLS
-	int ub_asa_iter = 9999;  // ASA
-	int ub_asa_time = 180;  // ASAʱʱ
-	int filter_width = 2;   //BeamSearchÿparent nodeµnode
-	int beam_width = 3;     //BeamSearchÿһΪparent node
+	int ub_rls_iter = 9999;  // RLS最大迭代次数
+	int ub_asa_iter = 9999;  // ASA最大迭代次数
+	int ub_asa_time = 180;  // ASA超时时间
+	int filter_width = 2;   //BeamSearch中每个parent node能留下的子node数量
+	int beam_width = 3;     //BeamSearch中每一代留下作为parent node的数量
+	int worker_num = 0;     //并行求解的工作线程数，0表示取硬件并发数
+	bool whole_skyline = false; //RLS解码时每个块在整条skyline上找最低的位置，否则在最低的skyline上挑块
+	int rls_batch = 1;      //RLS每轮同时解码的邻域数，大于1时在线程池上并行解码并接受其中最好的改进，结果与线程数无关
 	coord_t lb_width = 50, ub_width = 400;
 	coord_t lb_height = 50, ub_height = 300;
-	double lb_scale = 0.9, ub_scale = 1.1;    //ɺѡȵCWGAеĦͦ
+	double lb_scale = 0.9, ub_scale = 1.1;    //生成候选宽度的CWGA方法中的α和β
 } cfg;
 
 #endif // SMARTMPW_CONFIG_HPP
@@ -6,8 +6,13 @@
 #define SMARTMPW_DATA_HPP
 
 #include <vector>
+#include <map>
 #include <memory>
+#include <cstdint>
 #include <cassert>
+#include <limits>
+#include <algorithm>
+#include <initializer_list>
 
 #include "Config.hpp"
 
@@ -26,7 +31,7 @@ struct Point {
 };
 
 template<typename T>
-struct Segment {                  //һsegmentһߣ㣬յ㣨еĶȡ˳򣩣յĸ򣩣
+struct Segment {                  //一个segment是一条边，包含起点，终点（按从算例中的读取顺序），方向（由起点和终点决定，上下左右四个方向），长度
 	Point<T> beg;
 	Point<T> end;
 	Direction dir;
@@ -76,12 +81,12 @@ struct Segment {                  //һ
 template<typename T>
 struct Polygon {
 	const int id;
-	const std::shared_ptr<const std::vector<Point<T>>> in_points; // 
+	const std::shared_ptr<const std::vector<Point<T>>> in_points; // 输入坐标序列
 	T area;
 	T max_length;
-	Point<T> lb_point; // ο꣨⣩
-	Rotation rotation; // תǶȣ⣩
-	std::vector<Point<T>> out_points; // 
+	Point<T> lb_point; // 参考坐标（求解）
+	Rotation rotation; // 旋转角度（求解）
+	std::vector<Point<T>> out_points; // 输出坐标序列
 
 	Polygon(int id_, const std::vector<Point<T>> &points, const std::vector<Segment<T>> &segments) :
 		id(id_), in_points(std::make_shared<const std::vector<Point<T>>>(points)),
@@ -90,7 +95,8 @@ struct Polygon {
 			[](const Segment<T> &lhs, const Segment<T> &rhs) { return lhs.len < rhs.len; })->len) {}
 
 	virtual Shape shape() = 0;
-	virtual void to_out_points() = 0; // lb_pointrotationȷout_pointsдsolļʱü
+	virtual void to_out_points(const Point<T> &lb_point, Rotation rotation, std::vector<Point<T>> &out_points) const = 0; // 按参考坐标和旋转角度计算输出坐标，仅写sol文件时调用即可
+	void to_out_points() { to_out_points(lb_point, rotation, out_points); }
 };
 
 template<typename T>
@@ -108,15 +114,15 @@ struct Rect : public Polygon<T> {
 
 	Shape shape() { return Shape::R; }
 
-	void to_out_points() {
-		this->out_points.clear();
-		this->out_points.reserve(4);
+	void to_out_points(const Point<T> &lb_point, Rotation rotation, std::vector<Point<T>> &out_points) const {
+		out_points.clear();
+		out_points.reserve(4);
 		coord_t w = width, h = height;
-		if (this->rotation == Rotation::_90_) { std::swap(w, h); }
-		this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-		this->out_points.emplace_back(this->lb_point.x, this->lb_point.y + h);
-		this->out_points.emplace_back(this->lb_point.x + w, this->lb_point.y + h);
-		this->out_points.emplace_back(this->lb_point.x + w, this->lb_point.y);
+		if (rotation == Rotation::_90_) { std::swap(w, h); }
+		out_points.emplace_back(lb_point.x, lb_point.y);
+		out_points.emplace_back(lb_point.x, lb_point.y + h);
+		out_points.emplace_back(lb_point.x + w, lb_point.y + h);
+		out_points.emplace_back(lb_point.x + w, lb_point.y);
 	}
 };
 
@@ -141,11 +147,11 @@ struct LShape : public Polygon<T> {
 			default:               assert(false);           break;
 			}
 		}
-		//LINE 146-225 :LShapeÿߡ ÿһLShapeͨתʾɱ׼LΡL£һhuʱֱvlhdvrhmvmhu
-		//ڶȡʱܰ˳ʱʱȡ˴
+		//LINE 146-225 :标记LShape的每条边。 每一个LShape都可以通过旋转表示成标准的L形。在这种L形下，最上面一条边是hu，逆时针遍历分别是vl，hd，vr，hm，vm，hu
+		//边在读取的时候可能按顺时针或逆时针读取，这里做了处理。
 		if (up_segs.size() == 1 && left_segs.size() == 1) {
 			assert(down_segs.size() == 2 && right_segs.size() == 2);
-			if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Up) { // ˳
+			if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 顺
 				hd = segments[left_segs[0]].len;
 				vl = segments[(left_segs[0] + 1) % segments.size()].len;
 				hu = segments[(left_segs[0] + 2) % segments.size()].len;
@@ -153,7 +159,7 @@ struct LShape : public Polygon<T> {
 				hm = segments[(left_segs[0] + 4) % segments.size()].len;
 				vr = segments[(left_segs[0] + 5) % segments.size()].len;
 			}
-			else if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 
+			else if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 逆
 				hd = segments[left_segs[0]].len;
 				vr = segments[(left_segs[0] + 1) % segments.size()].len;
 				hm = segments[(left_segs[0] + 2) % segments.size()].len;
@@ -165,7 +171,7 @@ struct LShape : public Polygon<T> {
 		}
 		else if (up_segs.size() == 1 && right_segs.size() == 1) {
 			assert(down_segs.size() == 2 && left_segs.size() == 2);
-			if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Right) { // ˳
+			if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 顺
 				hd = segments[up_segs[0]].len;
 				vl = segments[(up_segs[0] + 1) % segments.size()].len;
 				hu = segments[(up_segs[0] + 2) % segments.size()].len;
@@ -173,7 +179,7 @@ struct LShape : public Polygon<T> {
 				hm = segments[(up_segs[0] + 4) % segments.size()].len;
 				vr = segments[(up_segs[0] + 5) % segments.size()].len;
 			}
-			else if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 
+			else if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 逆
 				hd = segments[up_segs[0]].len;
 				vr = segments[(up_segs[0] + 1) % segments.size()].len;
 				hm = segments[(up_segs[0] + 2) % segments.size()].len;
@@ -185,7 +191,7 @@ struct LShape : public Polygon<T> {
 		}
 		else if (down_segs.size() == 1 && left_segs.size() == 1) {
 			assert(up_segs.size() == 2 && right_segs.size() == 2);
-			if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Left) { // ˳
+			if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 顺
 				hd = segments[down_segs[0]].len;
 				vl = segments[(down_segs[0] + 1) % segments.size()].len;
 				hu = segments[(down_segs[0] + 2) % segments.size()].len;
@@ -193,7 +199,7 @@ struct LShape : public Polygon<T> {
 				hm = segments[(down_segs[0] + 4) % segments.size()].len;
 				vr = segments[(down_segs[0] + 5) % segments.size()].len;
 			}
-			else if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 
+			else if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 逆
 				hd = segments[down_segs[0]].len;
 				vr = segments[(down_segs[0] + 1) % segments.size()].len;
 				hm = segments[(down_segs[0] + 2) % segments.size()].len;
@@ -205,7 +211,7 @@ struct LShape : public Polygon<T> {
 		}
 		else if (down_segs.size() == 1 && right_segs.size() == 1) {
 			assert(up_segs.size() == 2 && left_segs.size() == 2);
-			if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Down) { // ˳
+			if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 顺
 				hd = segments[right_segs[0]].len;
 				vl = segments[(right_segs[0] + 1) % segments.size()].len;
 				hu = segments[(right_segs[0] + 2) % segments.size()].len;
@@ -213,7 +219,7 @@ struct LShape : public Polygon<T> {
 				hm = segments[(right_segs[0] + 4) % segments.size()].len;
 				vr = segments[(right_segs[0] + 5) % segments.size()].len;
 			}
-			else if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 
+			else if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 逆
 				hd = segments[right_segs[0]].len;
 				vr = segments[(right_segs[0] + 1) % segments.size()].len;
 				hm = segments[(right_segs[0] + 2) % segments.size()].len;
@@ -230,42 +236,42 @@ struct LShape : public Polygon<T> {
 	}
 
 	Shape shape() { return Shape::L; }
-	//LShapeĲοlb_pointΪ׼L½ǵ㣬תǶڱ׼Lεת˳ʱתǶȣ˳ʱ¼out_points
-	void to_out_points() {
-		this->out_points.clear();
-		this->out_points.reserve(6);
-		switch (this->rotation) {
+	//LShape的参考坐标lb_point为标准的L形左下角点，这里的旋转角度是相对于标准的L形的旋转，顺时针旋转角度，顺时针记录out_points
+	void to_out_points(const Point<T> &lb_point, Rotation rotation, std::vector<Point<T>> &out_points) const {
+		out_points.clear();
+		out_points.reserve(6);
+		switch (rotation) {
 		case Rotation::_0_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y + vl);
-			this->out_points.emplace_back(this->lb_point.x + hu, this->lb_point.y + vl);
-			this->out_points.emplace_back(this->lb_point.x + hu, this->lb_point.y + vr);
-			this->out_points.emplace_back(this->lb_point.x + hd, this->lb_point.y + vr);
-			this->out_points.emplace_back(this->lb_point.x + hd, this->lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y + vl);
+			out_points.emplace_back(lb_point.x + hu, lb_point.y + vl);
+			out_points.emplace_back(lb_point.x + hu, lb_point.y + vr);
+			out_points.emplace_back(lb_point.x + hd, lb_point.y + vr);
+			out_points.emplace_back(lb_point.x + hd, lb_point.y);
 			break;
 		case Rotation::_90_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x + vl, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x + vl, this->lb_point.y - hu);
-			this->out_points.emplace_back(this->lb_point.x + vr, this->lb_point.y - hu);
-			this->out_points.emplace_back(this->lb_point.x + vr, this->lb_point.y - hd);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y - hd);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x + vl, lb_point.y);
+			out_points.emplace_back(lb_point.x + vl, lb_point.y - hu);
+			out_points.emplace_back(lb_point.x + vr, lb_point.y - hu);
+			out_points.emplace_back(lb_point.x + vr, lb_point.y - hd);
+			out_points.emplace_back(lb_point.x, lb_point.y - hd);
 			break;
 		case Rotation::_180_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y - vl);
-			this->out_points.emplace_back(this->lb_point.x - hu, this->lb_point.y - vl);
-			this->out_points.emplace_back(this->lb_point.x - hu, this->lb_point.y - vr);
-			this->out_points.emplace_back(this->lb_point.x - hd, this->lb_point.y - vr);
-			this->out_points.emplace_back(this->lb_point.x - hd, this->lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y - vl);
+			out_points.emplace_back(lb_point.x - hu, lb_point.y - vl);
+			out_points.emplace_back(lb_point.x - hu, lb_point.y - vr);
+			out_points.emplace_back(lb_point.x - hd, lb_point.y - vr);
+			out_points.emplace_back(lb_point.x - hd, lb_point.y);
 			break;
 		case Rotation::_270_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x - vl, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x - vl, this->lb_point.y + hu);
-			this->out_points.emplace_back(this->lb_point.x - vr, this->lb_point.y + hu);
-			this->out_points.emplace_back(this->lb_point.x - vr, this->lb_point.y + hd);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y + hd);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x - vl, lb_point.y);
+			out_points.emplace_back(lb_point.x - vl, lb_point.y + hu);
+			out_points.emplace_back(lb_point.x - vr, lb_point.y + hu);
+			out_points.emplace_back(lb_point.x - vr, lb_point.y + hd);
+			out_points.emplace_back(lb_point.x, lb_point.y + hd);
 			break;
 		default:
 			assert(false);
@@ -296,11 +302,11 @@ struct TShape : public Polygon<T> {
 			}
 		}
 
-		//LINE 301-396 :TShapeÿߡ ÿһTShapeͨתʾɵTΡֵT£һhdʱֱvrd,hr,vru,hu,vlu,hl,vld,hd
-		//ڶȡʱܰ˳ʱʱȡ˴
+		//LINE 301-396 :标记TShape的每条边。 每一个TShape都可以通过旋转表示成倒T形。在这种倒T形下，最下面一条边是hd，逆时针遍历分别是vrd,hr,vru,hu,vlu,hl,vld,hd
+		//边在读取的时候可能按顺时针或逆时针读取，这里做了处理。
 		if (up_segs.size() == 1) {
 			assert(down_segs.size() == 3 && left_segs.size() == 2 && right_segs.size() == 2);
-			if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Right) { // ˳
+			if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 顺
 				hd = segments[up_segs[0]].len;
 				vld = segments[(up_segs[0] + 1) % segments.size()].len;
 				hl = segments[(up_segs[0] + 2) % segments.size()].len;
@@ -310,7 +316,7 @@ struct TShape : public Polygon<T> {
 				hr = segments[(up_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(up_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 
+			else if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 逆
 				hd = segments[up_segs[0]].len;
 				vrd = segments[(up_segs[0] + 1) % segments.size()].len;
 				hr = segments[(up_segs[0] + 2) % segments.size()].len;
@@ -324,7 +330,7 @@ struct TShape : public Polygon<T> {
 		}
 		else if (down_segs.size() == 1) {
 			assert(up_segs.size() == 3 && left_segs.size() == 2 && right_segs.size() == 2);
-			if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Left) { // ˳
+			if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 顺
 				hd = segments[down_segs[0]].len;
 				vld = segments[(down_segs[0] + 1) % segments.size()].len;
 				hl = segments[(down_segs[0] + 2) % segments.size()].len;
@@ -334,7 +340,7 @@ struct TShape : public Polygon<T> {
 				hr = segments[(down_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(down_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 
+			else if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 逆
 				hd = segments[down_segs[0]].len;
 				vrd = segments[(down_segs[0] + 1) % segments.size()].len;
 				hr = segments[(down_segs[0] + 2) % segments.size()].len;
@@ -348,7 +354,7 @@ struct TShape : public Polygon<T> {
 		}
 		else if (left_segs.size() == 1) {
 			assert(right_segs.size() == 3 && up_segs.size() == 2 && down_segs.size() == 2);
-			if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Up) { // ˳
+			if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 顺
 				hd = segments[left_segs[0]].len;
 				vld = segments[(left_segs[0] + 1) % segments.size()].len;
 				hl = segments[(left_segs[0] + 2) % segments.size()].len;
@@ -358,7 +364,7 @@ struct TShape : public Polygon<T> {
 				hr = segments[(left_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(left_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 
+			else if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 逆
 				hd = segments[left_segs[0]].len;
 				vrd = segments[(left_segs[0] + 1) % segments.size()].len;
 				hr = segments[(left_segs[0] + 2) % segments.size()].len;
@@ -372,7 +378,7 @@ struct TShape : public Polygon<T> {
 		}
 		else if (right_segs.size() == 1) {
 			assert(left_segs.size() == 3 && up_segs.size() == 2 && down_segs.size() == 2);
-			if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Down) { // ˳
+			if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 顺
 				hd = segments[right_segs[0]].len;
 				vld = segments[(right_segs[0] + 1) % segments.size()].len;
 				hl = segments[(right_segs[0] + 2) % segments.size()].len;
@@ -382,7 +388,7 @@ struct TShape : public Polygon<T> {
 				hr = segments[(right_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(right_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 
+			else if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 逆
 				hd = segments[right_segs[0]].len;
 				vrd = segments[(right_segs[0] + 1) % segments.size()].len;
 				hr = segments[(right_segs[0] + 2) % segments.size()].len;
@@ -401,50 +407,50 @@ struct TShape : public Polygon<T> {
 	}
 
 	Shape shape() { return Shape::T; }
-	//TShapeĲοlb_pointΪT½ǵ㣬תǶڵTεת˳ʱתǶȣ˳ʱ¼out_points
-	void to_out_points() {
-		this->out_points.clear();
-		this->out_points.reserve(8);
-		switch (this->rotation) {
+	//TShape的参考坐标lb_point为倒T形左下角点，这里的旋转角度是相对于倒T形的旋转，顺时针旋转角度，顺时针记录out_points
+	void to_out_points(const Point<T> &lb_point, Rotation rotation, std::vector<Point<T>> &out_points) const {
+		out_points.clear();
+		out_points.reserve(8);
+		switch (rotation) {
 		case Rotation::_0_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y + vld);
-			this->out_points.emplace_back(this->lb_point.x + hl, this->lb_point.y + vld);
-			this->out_points.emplace_back(this->lb_point.x + hl, this->lb_point.y + vld + vlu);
-			this->out_points.emplace_back(this->lb_point.x + hl + hu, this->lb_point.y + vld + vlu);
-			this->out_points.emplace_back(this->lb_point.x + hl + hu, this->lb_point.y + vrd);
-			this->out_points.emplace_back(this->lb_point.x + hd, this->lb_point.y + vrd);
-			this->out_points.emplace_back(this->lb_point.x + hd, this->lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y + vld);
+			out_points.emplace_back(lb_point.x + hl, lb_point.y + vld);
+			out_points.emplace_back(lb_point.x + hl, lb_point.y + vld + vlu);
+			out_points.emplace_back(lb_point.x + hl + hu, lb_point.y + vld + vlu);
+			out_points.emplace_back(lb_point.x + hl + hu, lb_point.y + vrd);
+			out_points.emplace_back(lb_point.x + hd, lb_point.y + vrd);
+			out_points.emplace_back(lb_point.x + hd, lb_point.y);
 			break;
 		case Rotation::_90_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x + vld, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x + vld, this->lb_point.y - hl);
-			this->out_points.emplace_back(this->lb_point.x + vld + vlu, this->lb_point.y - hl);
-			this->out_points.emplace_back(this->lb_point.x + vld + vlu, this->lb_point.y - hl - hu);
-			this->out_points.emplace_back(this->lb_point.x + vrd, this->lb_point.y - hl - hu);
-			this->out_points.emplace_back(this->lb_point.x + vrd, this->lb_point.y - hd);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y - hd);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x + vld, lb_point.y);
+			out_points.emplace_back(lb_point.x + vld, lb_point.y - hl);
+			out_points.emplace_back(lb_point.x + vld + vlu, lb_point.y - hl);
+			out_points.emplace_back(lb_point.x + vld + vlu, lb_point.y - hl - hu);
+			out_points.emplace_back(lb_point.x + vrd, lb_point.y - hl - hu);
+			out_points.emplace_back(lb_point.x + vrd, lb_point.y - hd);
+			out_points.emplace_back(lb_point.x, lb_point.y - hd);
 			break;
 		case Rotation::_180_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y - vld);
-			this->out_points.emplace_back(this->lb_point.x - hl, this->lb_point.y - vld);
-			this->out_points.emplace_back(this->lb_point.x - hl, this->lb_point.y - vld - vlu);
-			this->out_points.emplace_back(this->lb_point.x - hl - hu, this->lb_point.y - vld - vlu);
-			this->out_points.emplace_back(this->lb_point.x - hl - hu, this->lb_point.y - vrd);
-			this->out_points.emplace_back(this->lb_point.x - hd, this->lb_point.y - vrd);
-			this->out_points.emplace_back(this->lb_point.x - hd, this->lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x, lb_point.y - vld);
+			out_points.emplace_back(lb_point.x - hl, lb_point.y - vld);
+			out_points.emplace_back(lb_point.x - hl, lb_point.y - vld - vlu);
+			out_points.emplace_back(lb_point.x - hl - hu, lb_point.y - vld - vlu);
+			out_points.emplace_back(lb_point.x - hl - hu, lb_point.y - vrd);
+			out_points.emplace_back(lb_point.x - hd, lb_point.y - vrd);
+			out_points.emplace_back(lb_point.x - hd, lb_point.y);
 			break;
 		case Rotation::_270_:
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x - vld, this->lb_point.y);
-			this->out_points.emplace_back(this->lb_point.x - vld, this->lb_point.y + hl);
-			this->out_points.emplace_back(this->lb_point.x - vld - vlu, this->lb_point.y + hl);
-			this->out_points.emplace_back(this->lb_point.x - vld - vlu, this->lb_point.y + hl + hu);
-			this->out_points.emplace_back(this->lb_point.x - vrd, this->lb_point.y + hl + hu);
-			this->out_points.emplace_back(this->lb_point.x - vrd, this->lb_point.y + hd);
-			this->out_points.emplace_back(this->lb_point.x, this->lb_point.y + hd);
+			out_points.emplace_back(lb_point.x, lb_point.y);
+			out_points.emplace_back(lb_point.x - vld, lb_point.y);
+			out_points.emplace_back(lb_point.x - vld, lb_point.y + hl);
+			out_points.emplace_back(lb_point.x - vld - vlu, lb_point.y + hl);
+			out_points.emplace_back(lb_point.x - vld - vlu, lb_point.y + hl + hu);
+			out_points.emplace_back(lb_point.x - vrd, lb_point.y + hl + hu);
+			out_points.emplace_back(lb_point.x - vrd, lb_point.y + hd);
+			out_points.emplace_back(lb_point.x, lb_point.y + hd);
 			break;
 		default:
 			assert(false);
@@ -475,12 +481,12 @@ struct Concave : public Polygon<T> {
 			}
 		}
 
-		//LINE 481-576 :Concaveÿߡ ÿһConcaveͨתʾɱ׼UΡֱ׼U£һhd
-		// ʱֱvrd,hr,vru,hu,vlu,hl,vld,hd
-		//ڶȡʱܰ˳ʱʱȡ˴
+		//LINE 481-576 :标记Concave的每条边。 每一个Concave都可以通过旋转表示成标准的U形。在这种标准的U形下，最下面一条边是hd，
+		// 逆时针遍历分别是vrd,hr,vru,hu,vlu,hl,vld,hd
+		//边在读取的时候可能按顺时针或逆时针读取，这里做了处理。
 		if (up_segs.size() == 1) {
 			assert(down_segs.size() == 3 && left_segs.size() == 2 && right_segs.size() == 2);
-			if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Right) { // ˳
+			if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 顺
 				hd = segments[up_segs[0]].len;
 				vld = segments[(up_segs[0] + 1) % segments.size()].len;
 				hl = segments[(up_segs[0] + 2) % segments.size()].len;
@@ -490,7 +496,7 @@ struct Concave : public Polygon<T> {
 				hr = segments[(up_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(up_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 
+			else if (segments[(up_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 逆
 				hd = segments[up_segs[0]].len;
 				vrd = segments[(up_segs[0] + 1) % segments.size()].len;
 				hr = segments[(up_segs[0] + 2) % segments.size()].len;
@@ -504,7 +510,7 @@ struct Concave : public Polygon<T> {
 		}
 		else if (down_segs.size() == 1) {
 			assert(up_segs.size() == 3 && left_segs.size() == 2 && right_segs.size() == 2);
-			if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Left) { // ˳
+			if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Left) { // 顺
 				hd = segments[down_segs[0]].len;
 				vld = segments[(down_segs[0] + 1) % segments.size()].len;
 				hl = segments[(down_segs[0] + 2) % segments.size()].len;
@@ -514,7 +520,7 @@ struct Concave : public Polygon<T> {
 				hr = segments[(down_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(down_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 
+			else if (segments[(down_segs[0] + 1) % segments.size()].dir == Direction::Right) { // 逆
 				hd = segments[down_segs[0]].len;
 				vrd = segments[(down_segs[0] + 1) % segments.size()].len;
 				hr = segments[(down_segs[0] + 2) % segments.size()].len;
@@ -528,7 +534,7 @@ struct Concave : public Polygon<T> {
 		}
 		else if (left_segs.size() == 1) {
 			assert(right_segs.size() == 3 && up_segs.size() == 2 && down_segs.size() == 2);
-			if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Up) { // ˳
+			if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 顺
 				hd = segments[left_segs[0]].len;
 				vld = segments[(left_segs[0] + 1) % segments.size()].len;
 				hl = segments[(left_segs[0] + 2) % segments.size()].len;
@@ -538,7 +544,7 @@ struct Concave : public Polygon<T> {
 				hr = segments[(left_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(left_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 
+			else if (segments[(left_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 逆
 				hd = segments[left_segs[0]].len;
 				vrd = segments[(left_segs[0] + 1) % segments.size()].len;
 				hr = segments[(left_segs[0] + 2) % segments.size()].len;
@@ -552,7 +558,7 @@ struct Concave : public Polygon<T> {
 		}
 		else if (right_segs.size() == 1) {
 			assert(left_segs.size() == 3 && up_segs.size() == 2 && down_segs.size() == 2);
-			if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Down) { // ˳
+			if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Down) { // 顺
 				hd = segments[right_segs[0]].len;
 				vld = segments[(right_segs[0] + 1) % segments.size()].len;
 				hl = segments[(right_segs[0] + 2) % segments.size()].len;
@@ -562,7 +568,7 @@ struct Concave : public Polygon<T> {
 				hr = segments[(right_segs[0] + 6) % segments.size()].len;
 				vrd = segments[(right_segs[0] + 7) % segments.size()].len;
 			}
-			else if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 
+			else if (segments[(right_segs[0] + 1) % segments.size()].dir == Direction::Up) { // 逆
 				hd = segments[right_segs[0]].len;
 				vrd = segments[(right_segs[0] + 1) % segments.size()].len;
 				hr = segments[(right_segs[0] + 2) % segments.size()].len;
@@ -581,19 +587,19 @@ struct Concave : public Polygon<T> {
 	}
 
 	Shape shape() { return Shape::C; }
-	//ConcaveĲοlb_pointΪ׼U½ǵ㣬ûתǶȣֻܰ׼Uηã˳ʱ¼out_points
-	void to_out_points() {
-		this->out_points.clear();
-		this->out_points.reserve(8);
-		assert(this->rotation == Rotation::_0_);
-		this->out_points.emplace_back(this->lb_point.x, this->lb_point.y);
-		this->out_points.emplace_back(this->lb_point.x, this->lb_point.y + vld);
-		this->out_points.emplace_back(this->lb_point.x + hl, this->lb_point.y + vld);
-		this->out_points.emplace_back(this->lb_point.x + hl, this->lb_point.y + vld - vlu);
-		this->out_points.emplace_back(this->lb_point.x + hl + hu, this->lb_point.y + vld - vlu);
-		this->out_points.emplace_back(this->lb_point.x + hl + hu, this->lb_point.y + vrd);
-		this->out_points.emplace_back(this->lb_point.x + hd, this->lb_point.y + vrd);
-		this->out_points.emplace_back(this->lb_point.x + hd, this->lb_point.y);
+	//Concave的参考坐标lb_point为标准U形左下角点，没有旋转角度，只能按标准U形放置，顺时针记录out_points
+	void to_out_points(const Point<T> &lb_point, Rotation rotation, std::vector<Point<T>> &out_points) const {
+		out_points.clear();
+		out_points.reserve(8);
+		assert(rotation == Rotation::_0_);
+		out_points.emplace_back(lb_point.x, lb_point.y);
+		out_points.emplace_back(lb_point.x, lb_point.y + vld);
+		out_points.emplace_back(lb_point.x + hl, lb_point.y + vld);
+		out_points.emplace_back(lb_point.x + hl, lb_point.y + vld - vlu);
+		out_points.emplace_back(lb_point.x + hl + hu, lb_point.y + vld - vlu);
+		out_points.emplace_back(lb_point.x + hl + hu, lb_point.y + vrd);
+		out_points.emplace_back(lb_point.x + hd, lb_point.y + vrd);
+		out_points.emplace_back(lb_point.x + hd, lb_point.y);
 	}
 };
 
@@ -603,6 +609,210 @@ struct SkyLineNode {
 	T width;
 };
 
+/// 一次放置的记录：多边形id、旋转角度和参考坐标，解码时只记录这些，输出时再由Polygon::to_out_points展开
+template<typename T>
+struct Placement {
+	uint32_t id : 30;
+	uint32_t rotation : 2; // Rotation
+	T x, y;
+
+	Placement() : id(0), rotation(Rotation::_0_), x(0), y(0) {}
+	Placement(size_t id_, Rotation rotation_, T x_, T y_) :
+		id(static_cast<uint32_t>(id_)), rotation(rotation_), x(x_), y(y_) {}
+	explicit Placement(size_t id_) : Placement(id_, Rotation::_0_, 0, 0) {}
+	/// 紧凑坐标求解器的结果在输出前转换回coord_t
+	template<typename U>
+	explicit Placement(const Placement<U> &other) :
+		id(other.id), rotation(other.rotation), x(static_cast<T>(other.x)), y(static_cast<T>(other.y)) {}
+
+	Point<T> lb_point() const { return Point<T>(x, y); }
+	template<typename U>
+	void set_lb_point(const Point<U> &point) { x = static_cast<T>(point.x); y = static_cast<T>(point.y); }
+};
+
+static_assert(sizeof(Placement<int>) == 12, "placement record should stay 12 bytes");
+static_assert(sizeof(Placement<int16_t>) == 8, "compact placement record should stay 8 bytes");
+
+/// 矩形打分用到的尺寸，含义与Rect中的同名成员一致
+template<typename T>
+struct RectDims {
+	T width, height;
+};
+
+/// 放置后形状顶边的一段，height为相对于中段底边的高度
+template<typename T>
+struct ProfileNode {
+	T width, height;
+};
+
+/// L/T/C一种放置方式的轮廓，读入算例时由形状的尺寸算好，打分时所有放置方式都由同一个匹配过程处理
+/// 形状的中段落在当前skyline节点上，左右两侧可以各搭在一个相邻节点上
+template<typename T>
+struct OrientationProfile {
+	uint8_t rotation;         // Rotation
+	bool align_right;         // 中段靠右放置，否则靠左
+	bool allow_gap;           // 搭在相邻节点上时允许悬空，悬空的面积计为浪费；否则须正好贴合，也不比较浪费
+	T mid;                    // 中段宽度，也是这种放置方式所需的最小skyline宽度
+	T min_slack, max_slack;   // 当前节点宽度减去mid须落在此范围内
+	T hang_l, lift_l;         // 搭在左侧节点上的宽度及其底边高出中段底边的高度，不搭时宽度为0
+	T hang_r, lift_r;         // 搭在右侧节点上的宽度及其底边高出中段底边的高度，不搭时宽度为0
+	T top;                    // 顶边的最高点
+	T lb_dx, lb_dy;           // 参考点相对于(形状左端, 中段底边)的偏移
+	ProfileNode<T> tops[3];   // 从左到右的顶边，不足3段时其余宽度为0
+};
+
+/// 只读的多边形尺寸表，形状标签、矩形尺寸和L/T/C的放置轮廓分别连续存放，打分时不经过虚函数和shared_ptr
+/// Polygon继承体系只用于读入算例和输出解
+/// T为尺寸的存储类型，A为面积类型；紧凑坐标下尺寸用16位存放，面积仍需32位
+/// 形状、面积和各放置方式的轮廓都相同的多边形打分结果相同，归为一个等价类，类按首个成员出现的先后编号
+template<typename T, typename A = T>
+class PolygonCatalog {
+	template<typename, typename> friend class PolygonCatalog;
+
+public:
+	PolygonCatalog() {}
+
+	/// 从宽坐标的尺寸表收窄得到紧凑坐标的尺寸表，调用者需保证尺寸不越界
+	template<typename U, typename B>
+	explicit PolygonCatalog(const PolygonCatalog<U, B> &other) :
+		_shapes(other._shapes), _slots(other._slots), _profile_offsets(other._profile_offsets),
+		_classes(other._classes), _class_sizes(other._class_sizes) {
+		auto narrow = [](U value) { return static_cast<T>(value); };
+		_areas.reserve(other._areas.size());
+		for (B area : other._areas) { _areas.push_back(static_cast<A>(area)); }
+		for (auto &r : other._rects) { _rects.push_back({ narrow(r.width), narrow(r.height) }); }
+		_profiles.reserve(other._profiles.size());
+		for (auto &p : other._profiles) {
+			OrientationProfile<T> profile;
+			profile.rotation = p.rotation; profile.align_right = p.align_right;
+			profile.allow_gap = p.allow_gap;
+			profile.mid = narrow(p.mid);
+			profile.min_slack = narrow(p.min_slack);
+			profile.max_slack = p.max_slack == std::numeric_limits<U>::max() ? std::numeric_limits<T>::max() : narrow(p.max_slack);
+			profile.hang_l = narrow(p.hang_l); profile.lift_l = narrow(p.lift_l);
+			profile.hang_r = narrow(p.hang_r); profile.lift_r = narrow(p.lift_r);
+			profile.top = narrow(p.top);
+			profile.lb_dx = narrow(p.lb_dx); profile.lb_dy = narrow(p.lb_dy);
+			for (int i = 0; i < 3; ++i) { profile.tops[i] = { narrow(p.tops[i].width), narrow(p.tops[i].height) }; }
+			_profiles.push_back(profile);
+		}
+	}
+
+	explicit PolygonCatalog(const std::vector<std::shared_ptr<Polygon<T>>> &polygons) {
+		_shapes.reserve(polygons.size());
+		_slots.reserve(polygons.size());
+		_areas.reserve(polygons.size());
+		_profile_offsets.reserve(polygons.size() + 1);
+		for (auto &ptr : polygons) {
+			assert(ptr->id == static_cast<int>(_shapes.size()));
+			_shapes.push_back(ptr->shape());
+			_areas.push_back(ptr->area);
+			_slots.push_back(static_cast<uint32_t>(_rects.size()));
+			_profile_offsets.push_back(static_cast<uint32_t>(_profiles.size()));
+			switch (ptr->shape()) {
+			case Shape::R: {
+				auto &rect = dynamic_cast<const Rect<T> &>(*ptr);
+				_rects.push_back({ rect.width, rect.height });
+				break;
+			}
+			case Shape::L: { add_profiles(dynamic_cast<const LShape<T> &>(*ptr)); break; }
+			case Shape::T: { add_profiles(dynamic_cast<const TShape<T> &>(*ptr)); break; }
+			case Shape::C: { add_profiles(dynamic_cast<const Concave<T> &>(*ptr)); break; }
+			default: { assert(false); break; }
+			}
+		}
+		_profile_offsets.push_back(static_cast<uint32_t>(_profiles.size()));
+		assign_classes();
+	}
+
+	size_t size() const { return _shapes.size(); }
+	Shape shape(size_t id) const { return _shapes[id]; }
+	A area(size_t id) const { return _areas[id]; }
+
+	const RectDims<T> *rect(size_t id) const { assert(_shapes[id] == Shape::R); return &_rects[_slots[id]]; }
+
+	/// L/T/C各放置方式的轮廓，按打分时的尝试顺序排列，比较相同时先尝试的方式优先
+	const OrientationProfile<T> *profile_begin(size_t id) const { return _profiles.data() + _profile_offsets[id]; }
+	const OrientationProfile<T> *profile_end(size_t id) const { return _profiles.data() + _profile_offsets[id + 1]; }
+
+	/// 多边形所在的等价类，以及类的个数和各类的成员数
+	size_t class_of(size_t id) const { return _classes[id]; }
+	size_t class_num() const { return _class_sizes.size(); }
+	size_t class_size(size_t c) const { return _class_sizes[c]; }
+
+private:
+	/// 按形状、面积、矩形尺寸和全部轮廓的各字段比较，完全相同的归为同一类
+	void assign_classes() {
+		std::map<std::vector<int64_t>, uint32_t> class_ids;
+		std::vector<int64_t> key;
+		_classes.reserve(_shapes.size());
+		for (size_t id = 0; id < _shapes.size(); ++id) {
+			key.assign({ static_cast<int64_t>(_shapes[id]), static_cast<int64_t>(_areas[id]) });
+			if (_shapes[id] == Shape::R) { key.insert(key.end(), { rect(id)->width, rect(id)->height }); }
+			for (auto p = profile_begin(id); p != profile_end(id); ++p) {
+				key.insert(key.end(), { p->rotation, p->align_right, p->allow_gap, p->mid, p->min_slack, p->max_slack,
+					p->hang_l, p->lift_l, p->hang_r, p->lift_r, p->top, p->lb_dx, p->lb_dy });
+				for (auto &node : p->tops) { key.insert(key.end(), { node.width, node.height }); }
+			}
+			auto res = class_ids.emplace(key, static_cast<uint32_t>(_class_sizes.size()));
+			if (res.second) { _class_sizes.push_back(0); }
+			_classes.push_back(res.first->second);
+			++_class_sizes[res.first->second];
+		}
+	}
+
+	void add_profile(Rotation rotation, bool align_right, bool allow_gap, T mid, T min_slack, T max_slack,
+		T hang_l, T lift_l, T hang_r, T lift_r, T lb_dx, T lb_dy, std::initializer_list<ProfileNode<T>> tops) {
+		assert(tops.size() <= 3);
+		OrientationProfile<T> profile{ static_cast<uint8_t>(rotation), align_right, allow_gap,
+			mid, min_slack, max_slack, hang_l, lift_l, hang_r, lift_r, 0, lb_dx, lb_dy, {} };
+		std::copy(tops.begin(), tops.end(), profile.tops);
+		for (auto &node : tops) { profile.top = std::max(profile.top, node.height); }
+		_profiles.push_back(profile);
+	}
+
+	void add_profiles(const LShape<T> &l) {
+		const T any = std::numeric_limits<T>::max();
+		add_profile(Rotation::_0_, false, false, l.hd, 0, any, 0, 0, 0, 0, 0, 0, { { l.hu, l.vl }, { l.hm, l.vr } });         // 0&靠左
+		add_profile(Rotation::_0_, true, false, l.hd, 1, any, 0, 0, 0, 0, 0, 0, { { l.hu, l.vl }, { l.hm, l.vr } });          // 0&靠右
+		add_profile(Rotation::_270_, false, false, l.vl, 0, any, 0, 0, 0, 0, l.vl, 0, { { l.vm, l.hu }, { l.vr, l.hd } });    // 270&靠左
+		add_profile(Rotation::_270_, true, false, l.vl, 1, any, 0, 0, 0, 0, l.vl, 0, { { l.vm, l.hu }, { l.vr, l.hd } });     // 270&靠右
+		add_profile(Rotation::_90_, true, true, l.vr, 0, any, 0, 0, l.vm, l.hd - l.hu, 0, l.hd, { { l.vl, l.hd } });          // 90，vm搭在右侧
+		add_profile(Rotation::_180_, false, true, l.hu, 0, any, l.hm, l.vl - l.vr, 0, 0, l.hd, l.vl, { { l.hd, l.vl } });     // 180，hm搭在左侧
+	}
+
+	void add_profiles(const TShape<T> &t) {
+		const T any = std::numeric_limits<T>::max();
+		add_profile(Rotation::_0_, false, false, t.hd, 0, any, 0, 0, 0, 0, 0, 0,
+			{ { t.hl, t.vld }, { t.hu, t.vld + t.vlu }, { t.hr, t.vrd } });                                                  // 0&靠左，倒T
+		add_profile(Rotation::_0_, true, false, t.hd, 1, any, 0, 0, 0, 0, 0, 0,
+			{ { t.hl, t.vld }, { t.hu, t.vld + t.vlu }, { t.hr, t.vrd } });                                                  // 0&靠右
+		add_profile(Rotation::_90_, true, false, t.vrd, 0, any, 0, 0, t.vru, t.hr, 0, t.hd,
+			{ { t.vld, t.hd }, { t.vlu, t.hd - t.hl } });                                                                    // 90，vru搭在右侧
+		add_profile(Rotation::_180_, false, false, t.hu, 0, 0, t.hr, t.vru, t.hl, t.vlu, t.hd, t.vlu + t.vld,
+			{ { t.hd, t.vru + t.vrd } });                                                                                    // 180，正T嵌入
+		add_profile(Rotation::_270_, false, false, t.vld, 0, any, t.vlu, t.hl, 0, 0, t.vlu + t.vld, 0,
+			{ { t.vru, t.hl + t.hu }, { t.vrd, t.hd } });                                                                    // 270，vlu搭在左侧
+	}
+
+	void add_profiles(const Concave<T> &c) {
+		const T any = std::numeric_limits<T>::max();
+		add_profile(Rotation::_0_, false, false, c.hd, 0, any, 0, 0, 0, 0, 0, 0,
+			{ { c.hl, c.vld }, { c.hu, c.vld - c.vlu }, { c.hr, c.vrd } });                                                  // 0&靠左
+		add_profile(Rotation::_0_, true, false, c.hd, 1, any, 0, 0, 0, 0, 0, 0,
+			{ { c.hl, c.vld }, { c.hu, c.vld - c.vlu }, { c.hr, c.vrd } });                                                  // 0&靠右
+	}
+
+	std::vector<Shape> _shapes;      // 按多边形id
+	std::vector<uint32_t> _slots;    // 按多边形id，矩形在_rects中的下标
+	std::vector<A> _areas;           // 按多边形id
+	std::vector<RectDims<T>> _rects;
+	std::vector<uint32_t> _profile_offsets;       // 按多边形id，多边形的轮廓在_profiles中的起始下标，末尾多存一项
+	std::vector<OrientationProfile<T>> _profiles;
+	std::vector<uint32_t> _classes;      // 按多边形id，所在的等价类
+	std::vector<uint32_t> _class_sizes;  // 按等价类
+};
+
 using point_t = Point<coord_t>;
 
 using segment_t = Segment<coord_t>;
@@ -629,6 +839,14 @@ using concave_ptr = std::shared_ptr<concave_t>;
 
 using skylinenode_t = SkyLineNode<coord_t>;
 
-using skyline_t = std::vector<skylinenode_t>;
+using placement_t = Placement<coord_t>;
+
+using rect_dims_t = RectDims<coord_t>;
+
+using profile_t = OrientationProfile<coord_t>;
+
+using catalog_t = PolygonCatalog<coord_t>;
+
+using compact_catalog_t = PolygonCatalog<compact_coord_t, coord_t>;
 
 #endif // SMARTMPW_DATA_HPP
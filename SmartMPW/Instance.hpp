@@ -9,6 +9,7 @@
 #include <list>
 #include <string>
 #include <fstream>
+#include <limits>
 
 #include "Data.hpp"
 #include "Utils.hpp"
@@ -58,7 +59,16 @@ public:
 
 	const vector<polygon_ptr>& get_polygon_ptrs()  const { return _polygon_ptrs; }
 
-	// [todo] ԤϲL/Tɾ
+	const catalog_t& get_catalog() const { return _catalog; }
+
+	/// 所有形状最长边之和，skyline高度、形状尺寸和按区间生成的候选宽度都不会超过它
+	/// 按面积开方生成的候选宽度可能超过它，如形状很少或有一个很大的形状时
+	coord_t get_coord_bound() const { return _coord_bound; }
+
+	/// 最大候选宽度为max_width时，坐标上界能否放进compact_coord_t，能放进时求解器改用紧凑坐标
+	bool fits_compact_coord(coord_t max_width) const { return max(_coord_bound, max_width) <= numeric_limits<compact_coord_t>::max(); }
+
+	// [todo] 预处理，合并部分L/T成矩形
 	void pre_combine() {}
 
 private:
@@ -74,6 +84,7 @@ private:
 
 		_polygon_num = 0;
 		_total_area = 0;
+		_coord_bound = 0;
 		string line;
 		while (getline(ifs, line)) 
 		{
@@ -95,20 +106,14 @@ private:
 			{
 				case 4: 
 				{
-					//_polygon_ptrs.emplace_back(make_shared<rect_t>(_polygon_num++, in_points, in_segments));
-					//_rects.push_back(*dynamic_pointer_cast<rect_t>(_polygon_ptrs.back()));
-					_rects.emplace_back(_polygon_num++, in_points, in_segments);
-					_polygon_ptrs.emplace_back(make_shared<rect_t>(_rects.back()));
-					_total_area += _rects.back().area;
+					_polygon_ptrs.emplace_back(make_shared<rect_t>(_polygon_num++, in_points, in_segments));
+					_total_area += _polygon_ptrs.back()->area;
 					break;
 				}
 				case 6: 
 				{
-					//_polygon_ptrs.emplace_back(make_shared<lshape_t>(_polygon_num++, in_points, in_segments));
-					//_lshapes.push_back(*dynamic_pointer_cast<lshape_t>(_polygon_ptrs.back()));
-					_lshapes.emplace_back(_polygon_num++, in_points, in_segments);
-					_polygon_ptrs.emplace_back(make_shared<lshape_t>(_lshapes.back()));
-					_total_area += _lshapes.back().area;
+					_polygon_ptrs.emplace_back(make_shared<lshape_t>(_polygon_num++, in_points, in_segments));
+					_total_area += _polygon_ptrs.back()->area;
 					break;
 				}
 				case 8: 
@@ -117,20 +122,14 @@ private:
 					{
 						case Shape::T: 
 						{
-							//_polygon_ptrs.emplace_back(make_shared<tshape_t>(_polygon_num++, in_points, in_segments));
-							//_tshapes.push_back(*dynamic_pointer_cast<tshape_t>(_polygon_ptrs.back()));
-							_tshapes.emplace_back(_polygon_num++, in_points, in_segments);
-							_polygon_ptrs.emplace_back(make_shared<tshape_t>(_tshapes.back()));
-							_total_area += _tshapes.back().area;
+							_polygon_ptrs.emplace_back(make_shared<tshape_t>(_polygon_num++, in_points, in_segments));
+							_total_area += _polygon_ptrs.back()->area;
 							break;
 						}
 						case Shape::C: 
 						{
-							//_polygon_ptrs.emplace_back(make_shared<concave_t>(_polygon_num++, in_points, in_segments));
-							//_concaves.push_back(*dynamic_pointer_cast<concave_t>(_polygon_ptrs.back()));
-							_concaves.emplace_back(_polygon_num++, in_points, in_segments);
-							_polygon_ptrs.emplace_back(make_shared<concave_t>(_concaves.back()));
-							_total_area += _concaves.back().area;
+							_polygon_ptrs.emplace_back(make_shared<concave_t>(_polygon_num++, in_points, in_segments));
+							_total_area += _polygon_ptrs.back()->area;
 							break;
 						}
 						default: { assert(false); break; }
@@ -143,9 +142,11 @@ private:
 					break;
 			}
 		}
+		for (auto &ptr : _polygon_ptrs) { _coord_bound += ptr->max_length; }
+		_catalog = catalog_t(_polygon_ptrs);
 	}
 
-	// [todo] ظ͹ߵ
+	// [todo] 修正重复和共线的坐标点
 	vector<segment_t> transform_points_to_segments(const vector<point_t> &points) 
 	{
 		vector<segment_t> segments;
@@ -155,7 +156,7 @@ private:
 		return segments;
 	}
 
-	Shape get_shape_from_segments(const vector<segment_t> &segments) //еsegmentsת䷽һ󣩱εUͣ4T
+	Shape get_shape_from_segments(const vector<segment_t> &segments) //经历所有的segments，在这个过程中转弯方向（右或左）变了两次的是U型，4次是T型
 	{
 		int turn_count = 0;
 		Direction curr_turn = segments.back().next_turn(segments.front());
@@ -177,12 +178,10 @@ private:
 
 	vector<polygon_ptr> _polygon_ptrs;
 
-	list<rect_t> _rects;
-	list<lshape_t> _lshapes;
-	list<tshape_t> _tshapes;
-	list<concave_t> _concaves;
+	catalog_t _catalog;   // 打分用的尺寸表，与_polygon_ptrs按id对应
 
 	coord_t _total_area;
+	coord_t _coord_bound;
 	int _polygon_num;
 };
 
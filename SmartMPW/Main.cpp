@@ -12,6 +12,7 @@ void run_single_instance(const string& ins_str) {
 	asa.record_sol(env.solution_path());*/
 	BeamSearch bs(env, cfg);
 	bs.run();
+	bs.record_sol(env.solution_path());
 	//system("pause");
 
 #ifndef SUBMIT
@@ -2,350 +2,534 @@
 // @author   liyan
 // @contact  lyan_dut@outlook.com
 //
-//todo:307
+//todo:见307
 #ifndef SMARTMPW_MPWBINPACK_HPP
 #define SMARTMPW_MPWBINPACK_HPP
 
 #include <list>
+#include <deque>
+#include <unordered_map>
+#include <climits>
 #include <string>
-#include <unordered_set>
 #include <numeric>
 #include <algorithm>
+#include <atomic>
+#include <iostream>
 
 #include "Data.hpp"
+#include "Skyline.hpp"
+#include "PolygonPool.hpp"
+#include "TranspositionTable.hpp"
+#include "ProfileFit.hpp"
+#include "PlacementEvaluator.hpp"
+#include "Utils.hpp"
 
 namespace mbp {
 
 	using namespace std;
 
+	/// Coord为skyline节点、放置记录和尺寸表的存储类型，坐标上界能放进compact_coord_t的算例用它以减少占用的缓存
+	/// 打分时的局部计算和面积仍用coord_t
+	template<typename Coord = coord_t>
 	class MpwBinPack {
+	public:
+		using placement_t = Placement<Coord>;
+		using catalog_t = PolygonCatalog<Coord, coord_t>;
+
+	private:
+		using skylinenode_t = SkyLineNode<Coord>;
+		using skyline_t = Skyline<Coord>;
+		using rect_dims_t = RectDims<Coord>;
+		using profile_t = OrientationProfile<Coord>;
+
+		static constexpr int MaxSwapRetries = 16; // 交换动作随机重抽b的次数上限
+
+
+		/// 在整条skyline上试放的一种放置方式，底边轮廓、顶边和参考点的高度都相对于中段底边
+		struct WholeSkylineOrientation {
+			Rotation rotation;
+			coord_t width, top;
+			coord_t lb_dx, lb_dy;
+			size_t part_num;
+			BottomPart parts[3];
+			ProfileNode<coord_t> tops[3];  // 从左到右的顶边，不足3段时其余宽度为0
+		};
+
+		/// 一个块在整条skyline上的最优放置，x为形状左端，base为中段底边，height为放下后的最高点
+		struct WholeSkylineFit {
+			bool found;
+			WholeSkylineOrientation orientation;
+			coord_t x, base, height, gap;
 
-		/// 
+			WholeSkylineFit() : found(false) {}
+		};
+
+		/// 为最下最左的角挑选块时候选的比较状态：R比较打分，L先比较浪费再比较skyline节点数的变化量，T和C比较变化量
+		struct ChoiceKey {
+			int rect_score;
+			coord_t l_waste;
+			int ltc_delta;
+		};
+
+		/// 一步中对最优候选的一次更新，pos为候选在sequence中的位置，key为更新后的比较状态
+		struct ChoiceUpdate {
+			size_t pos;
+			ChoiceKey key;
+		};
+
+		/// RLS一次解码的记录，交换两个位置得到的邻域sequence据此重放选择不变的步
+		/// 每一步在最低的skyline上放置一个块，没有放得下的块时填坑
+		struct DecodeTrace {
+			/// 一步中比较状态与最终最优相同的多个候选，ties[begin, end)为它们的位置，递增排列，选中的是最靠前的
+			/// any_order为true时比较不满足传递性，这些候选的任意换序都可能改变选择
+			struct TieGroup {
+				size_t begin, end;
+				bool any_order;
+			};
+
+			vector<ChoiceUpdate> updates;  // 各步依次对最优候选的更新
+			vector<size_t> update_end;     // 第step步的更新为updates[update_end[step - 1], update_end[step])，没有更新的步为填坑
+			vector<size_t> ties;
+			vector<TieGroup> tie_groups;
+			vector<size_t> tie_group_end;  // 第step步的为tie_groups[tie_group_end[step - 1], tie_group_end[step])
+			vector<placement_t> dst;       // 依次做出的放置
+			coord_t height;                // 解码完成时的高度
+
+			void clear() { updates.clear(); update_end.clear(); ties.clear(); tie_groups.clear(); tie_group_end.clear(); dst.clear(); }
+
+			/// 交换a、b两处(a < b)的块后是否可能有一步的选择改变
+			/// 只有平局中的块换序才影响选择：最靠前的t1在a之前时不变；t1在a处时，(a, b]中还有平局的块就会换成它；
+			/// t1在a之后时，b处的块若在平局中且不是t1，就会换到a处成为最靠前的
+			bool swap_changes_choice(size_t a, size_t b) const {
+				for (const TieGroup &group : tie_groups) {
+					const size_t *first = ties.data() + group.begin, *last = ties.data() + group.end;
+					bool has_b = binary_search(first, last, b);
+					if (group.any_order) {
+						if (has_b || binary_search(first, last, a)) { return true; }
+					}
+					else if (*first == a) {
+						if (first[1] <= b) { return true; }
+					}
+					else if (*first > a && has_b && *first != b) { return true; }
+				}
+				return false;
+			}
+		};
+
+		/// 排序规则定义
 		struct SortRule {
 			vector<size_t> sequence;
 			coord_t target_area;
+			uint64_t key; // sequence的哈希，直接修改sequence后须调用rehash()
+			shared_ptr<const DecodeTrace> trace; // sequence的解码记录，RLS从中续解邻域sequence，可为空
+
+			/// sequence是排列，各元素在环上的后继和首元素唯一确定sequence，key为它们的Zobrist键的异或
+			/// 交换只改动至多4条后继边，轮转不改变后继边只改变首元素，两种邻域动作都能O(1)更新key
+			uint64_t full_key() const {
+				uint64_t res = head_key(sequence.front());
+				for (size_t i = 0; i < sequence.size(); ++i) { res ^= edge_key(i); }
+				return res;
+			}
+
+			void rehash() { key = full_key(); }
+
+			/// RLS访问记录的键：sequence连同当时的target_area，见sequential_local_search
+			uint64_t visit_key() const { return key ^ zobrist_mix(uint64_t(3) << 62 | uint32_t(target_area)); }
+
+			/// 交换a、b两处的元素
+			void swap_at(size_t a, size_t b) {
+				size_t n = sequence.size();
+				size_t edges[4] = { (a + n - 1) % n, a, (b + n - 1) % n, b }; // 以这些位置为起点的后继边会改变
+				sort(edges, edges + 4);
+				size_t edge_num = unique(edges, edges + 4) - edges;
+				for (size_t i = 0; i < edge_num; ++i) { key ^= edge_key(edges[i]); }
+				key ^= head_key(sequence.front());
+				swap(sequence[a], sequence[b]);
+				for (size_t i = 0; i < edge_num; ++i) { key ^= edge_key(edges[i]); }
+				key ^= head_key(sequence.front());
+				assert(key == full_key());
+			}
 
-			string tabu_key_str() const {
-				string key = to_string(sequence.front());
-				for (size_t i = 1; i < sequence.size(); ++i) { key += "," + to_string(sequence[i]); }
-				return key;
+			/// 轮转使sequence[a]成为首元素
+			void rotate_to(size_t a) {
+				key ^= head_key(sequence.front()) ^ head_key(sequence[a]);
+				rotate(sequence.begin(), sequence.begin() + a, sequence.end());
+				assert(key == full_key());
 			}
 
-			size_t tabu_key_hash() const { return hash<string>{}(tabu_key_str()); }
+		private:
+			uint64_t edge_key(size_t i) const { return zobrist_mix(uint64_t(sequence[i]) << 32 | sequence[(i + 1) % sequence.size()]); }
+			static uint64_t head_key(size_t id) { return zobrist_mix(uint64_t(1) << 63 | id); }
+		};
+
+		/// RLS的邻域动作，即撤销所需的记录：swapped时交换a、b两处，否则轮转使a处成为首元素
+		struct RuleMove {
+			bool swapped;
+			size_t a, b;
+		};
+
+		/// 放置前缀树的节点，同一parent的各子代共享parent及其祖先的放置
+		/// 节点存放在mbp_based_beamsearch的deque中，整个搜索结束前不释放
+		struct PlacementNode
+		{
+			const PlacementNode *parent;
+			placement_t placement;
+
+			PlacementNode(const PlacementNode *parent_, const placement_t &placement_) :
+				parent(parent_), placement(placement_) {}
 		};
 
 		struct intermediate_solu
 		{
-			skyline_t skyline;    //м⵱ǰγɵskyline
-			vector<polygon_ptr> _dst;      //ǰ_dst
-			double area_percentage;        //ѷõͼεռİٷֱ
-			list<size_t> polygons;        //ʣҪõ״
-			size_t current_height;           //ǰﵽ߶
-			size_t future_height;         //˳ʣ״Ϻܴﵽ߶
-			bool operator < (const intermediate_solu& x) const  //current_heightԽСԽãԴΪʱСǰ
+			skyline_t skyline;    //中间解当前形成的skyline
+			const PlacementNode *prefix;   //之前各步的放置，沿parent回溯得到
+			placement_t placement;         //本步的放置
+			bool placed;                   //本步是否放置了形状，填坑时为false
+			double placed_area;            //已放置的图形的总面积
+			double area_percentage;        //已放置的图形的总面积占包络矩形面积的百分比
+			PolygonPool polygons;        //剩余要放置的形状
+			size_t current_height;           //当前达到的最大高度
+			size_t future_height;         //按多边形输入顺序把剩余的形状放置完毕后能达到的最大高度
+			bool operator < (const intermediate_solu& x) const  //current_height越小越好，以此为依据时把这个小的排在前面
 			{
 				return current_height < x.current_height;
 			}
 
 		};
 
-		using TabuTable = unordered_set<string>;
-		using TabuFunc = string(SortRule::*)()const;
-		TabuFunc tabu_key = &SortRule::tabu_key_str;
-
-		//using TabuTable = unordered_set<size_t>;
-		//using TabuFunc = size_t(SortRule::*)()const;
-		//TabuFunc tabu_key = &SortRule::tabu_key_hash;
-
 	public:
 
 		MpwBinPack() = delete;
 
-		MpwBinPack(const vector<polygon_ptr> &src, coord_t width, coord_t height, default_random_engine &gen) :
-			_src(src), _bin_width(width), _bin_height(height), _obj_area(numeric_limits<coord_t>::max()),
-			_gen(gen), _uniform_dist(0, _src.size() - 1) {
+		MpwBinPack(const vector<polygon_ptr> &src, const catalog_t &catalog, coord_t width, coord_t height, unsigned int seed) :
+			_src(src), _catalog(catalog), _footprints(PolygonOrder::footprints(catalog)), _bin_width(width), _evaluator(catalog, width), _bin_height(height), _obj_area(numeric_limits<coord_t>::max()),
+			_incumbent_area(nullptr), _gen(seed), _uniform_dist(0, _src.size() - 1), _pool(nullptr),
+			_beam_table(14), _visited(12), _shared_rollouts(0), _decoded_steps(0), _noop_moves(0), _evaluated_moves(0),
+			_class_scores(catalog.class_num()), _class_stamps(catalog.class_num(), 0), _score_stamp(0) {
 			reset();
 			init_sort_rules();
+			_rect_groups.assign(_catalog.size(), PolygonOrder::NoGroup);
+			for (size_t id = 0; id < _catalog.size(); ++id) {
+				if (_catalog.shape(id) != Shape::R) { continue; }
+				auto res = _rect_index.emplace(dims_key(_catalog.rect(id)->width, _catalog.rect(id)->height), static_cast<uint32_t>(_rect_index.size()));
+				_rect_groups[id] = res.first->second;
+			}
 		}
 
-		const vector<polygon_ptr> &get_dst() const { return _dst; }
+		const vector<placement_t> &get_dst() const { return _dst; }
 
 		coord_t get_obj_area() const { return _obj_area; }
 
 		void set_obj_area(coord_t area) { _obj_area = area; }
 
-		void set_bin_height(coord_t height) { _bin_height = height; } // Ͻ
+		void set_bin_height(coord_t height) { _bin_height = height; } // 上界
 
-		coord_t get_skyline_height() const { // Űϱ߽
-			return max_element(_skyline.begin(), _skyline.end(),
-				[](const skylinenode_t &lhs, const skylinenode_t &rhs) { return lhs.y < rhs.y; })->y;
+		/// 与其他宽度的求解器共享的最优面积，RLS据此收紧上界并发布自己的改进
+		void set_incumbent(atomic<coord_t> *incumbent_area) { _incumbent_area = incumbent_area; }
+
+		/// beam search置换表的查询和命中次数
+		size_t get_tt_probes() const { return _beam_table.probes(); }
+		size_t get_tt_hits() const { return _beam_table.hits(); }
+
+		/// RLS生成的sequence数，以及其中因已解码过而跳过的个数
+		size_t get_visited_probes() const { return _visited.probes(); }
+		size_t get_visited_hits() const { return _visited.hits(); }
+		size_t get_visited_resets() const { return _visited.resets(); } // 过滤器置位过多而清空的次数
+
+		/// beam search中与同代更早的子代状态相同、沿用其rollout结果的子代数
+		size_t get_shared_rollouts() const { return _shared_rollouts; }
+
+		/// RLS解码实际执行的步数，重放的步不计
+		/// 批量RLS中线程池各求解器副本的解码步数也计入
+		size_t get_decoded_steps() const {
+			size_t steps = _decoded_steps;
+			for (const auto &worker : _workers) { steps += worker->_decoded_steps; }
+			return steps;
 		}
 
-		/// bin_widthRLS
+		/// RLS中因交换不影响任何一步的选择而跳过的邻域动作数，以及实际解码评估的邻域动作数
+		size_t get_noop_moves() const { return _noop_moves; }
+		size_t get_evaluated_moves() const { return _evaluated_moves; }
+
+		/// beam search的子代扩展和rollout、批量RLS的邻域解码使用的线程池，为空时串行执行
+		void set_thread_pool(utils::ThreadPool *pool) { _pool = pool; }
+
+		coord_t get_skyline_height() const { // 排版后的上边界
+			return _skyline.height();
+		}
+
+		/// 标记_skyline的当前状态，rollback()撤销此后在_skyline上的全部放置和填坑并弹出标记，代价只与改动的节点数有关
+		/// 标记可以嵌套，重新给_skyline赋值或reset()时丢弃全部标记；剩余多边形不在标记范围内
+		void push_mark() { _skyline.push_mark(); }
+		void rollback() { _skyline.rollback(); }
+
+		/// 基于bin_width进行RLS
 		void random_local_search(int iter) {
 			// the first time to call RLS on W_k
 			if (iter == 1) {
 				for (auto &rule : _sort_rules) {
-					_polygons.assign(rule.sequence.begin(), rule.sequence.end());
-					vector<polygon_ptr> target_dst;
-					bool first_insert = insert_bottom_left_score(target_dst);
-					assert(first_insert); // һαȫ
-					rule.target_area = _bin_width * get_skyline_height();
+					coord_t target_height;
+					bool first_insert = decode_rule(rule, target_height);
+					assert(first_insert); // 第一次必能全部放下
+					rule.target_area = _bin_width * target_height;
+					_visited.test_and_set(rule.visit_key());
 					if (rule.target_area < _obj_area) {
 						_obj_area = rule.target_area;
-						_dst = target_dst;
-						
+						_dst = _trace.dst;
+						update_incumbent(_obj_area);
 					}
+					rule.trace = make_shared<const DecodeTrace>(move(_trace));
 				}
-				// УԽĿ꺯ֵԽСѡиԽ
+				// 降序排列，越后面的目标函数值越小选中概率越大
 				sort(_sort_rules.begin(), _sort_rules.end(), [](const SortRule &lhs, const SortRule &rhs) {
 					return lhs.target_area > rhs.target_area; });
 			}
-			// Ż
 			SortRule &picked_rule = _sort_rules[_discrete_dist(_gen)];
+			if (cfg.rls_batch > 1) { batched_local_search(picked_rule, iter); }
+			else { sequential_local_search(picked_rule, iter); }
+			// 更新排序规则列表
+			sort(_sort_rules.begin(), _sort_rules.end(), [](const SortRule &lhs, const SortRule &rhs) {
+				return lhs.target_area > rhs.target_area; });
+		}
+
+		/// 逐个生成并解码picked_rule的iter个邻域，改进即接受
+		/// 邻域动作原地作用于picked_rule和_order，未被接受时原地撤销
+		void sequential_local_search(SortRule &picked_rule, int iter) {
+			load_sequence(picked_rule.sequence);
 			for (int i = 1; i <= iter; ++i) {
-				SortRule new_rule = picked_rule;
-				if (iter % 4) { swap_sort_rule(new_rule); }
-				else { rotate_sort_rule(new_rule); }
-
-				//if (_tabu_table.count((new_rule.*tabu_key)())) { continue; } // ѽ
-				//_tabu_table.insert((new_rule.*tabu_key)());
-
-				_polygons.assign(new_rule.sequence.begin(), new_rule.sequence.end());
-				vector<polygon_ptr> target_dst;
-				if (!insert_bottom_left_score(target_dst)) { continue; } // Ų
-				coord_t target_height = get_skyline_height();
-				new_rule.target_area = _bin_width * target_height;
-				if (new_rule.target_area < picked_rule.target_area) {
-					picked_rule = new_rule;
-					if (picked_rule.target_area < _obj_area) {
-						_obj_area = picked_rule.target_area;
-						cout << _obj_area << endl;
-						_dst = target_dst;
-						set_bin_height(target_height);
+				sync_bin_height();
+				RuleMove action = iter % 4 != 0 ? random_swap_move(picked_rule) : random_rotate_move();
+
+				// 交换的两个位置在每一步中都不影响选择，解码结果与picked_rule相同，不会更优
+				if (action.swapped && !cfg.whole_skyline && picked_rule.trace && !picked_rule.trace->swap_changes_choice(min(action.a, action.b), max(action.a, action.b))) {
+					++_noop_moves;
+					continue;
+				}
+
+				// 接受与否取决于picked_rule的target_area，规则之间各不相同，访问记录按(sequence, target_area)区分
+				// 在同一target_area下解码过的sequence不会被接受：当时放不下则_bin_height只会更小，当时放得下则面积不小于target_area
+				apply_move(picked_rule, action);
+				if (_visited.test_and_set(picked_rule.visit_key())) { undo_move(picked_rule, action); continue; }
+
+				++_evaluated_moves;
+				coord_t target_height;
+				if (!decode_loaded(target_height, action.swapped ? picked_rule.trace.get() : nullptr, action.a, action.b) // 放不下
+					|| _bin_width * target_height >= picked_rule.target_area) {
+					undo_move(picked_rule, action);
+					continue;
+				}
+				accept_decoded(picked_rule, target_height, _trace);
+			}
+		}
+
+		/// 每轮由picked_rule生成cfg.rls_batch个邻域，在线程池的各求解器副本上并行解码，只接受其中最好的改进，共iter个邻域
+		/// 生成和筛选都在调用线程上按顺序进行，各解码只依赖邻域的sequence、picked_rule的解码记录和本轮开始时的_bin_height，
+		/// 最好的改进先比较高度再比较生成顺序，因此结果只取决于种子和批量大小，与线程数无关
+		void batched_local_search(SortRule &picked_rule, int iter) {
+			size_t n = picked_rule.sequence.size();
+			for (int i = 1; i <= iter; i += cfg.rls_batch) {
+				sync_bin_height();
+				_batch_moves.clear();
+				for (int k = 0; k < cfg.rls_batch && i + k <= iter; ++k) {
+					RuleMove action = iter % 4 != 0 ? random_swap_move(picked_rule) : random_rotate_move();
+					if (action.swapped && !cfg.whole_skyline && picked_rule.trace && !picked_rule.trace->swap_changes_choice(min(action.a, action.b), max(action.a, action.b))) {
+						++_noop_moves;
+						continue;
 					}
+					// 同一批中重复的sequence也只解码第一个
+					move_rule(picked_rule, action);
+					bool visited = _visited.test_and_set(picked_rule.visit_key());
+					move_rule(picked_rule, inverse_move(action, n));
+					if (visited) { continue; }
+					_batch_moves.push_back(action);
 				}
+				if (_batch_moves.empty()) { continue; }
+				_evaluated_moves += _batch_moves.size();
+
+				// 调用线程自身也参与解码，_order和_trace因此不再与picked_rule同步
+				coord_t bin_height = _bin_height;
+				const DecodeTrace *base = picked_rule.trace.get();
+				_batch_heights.assign(_batch_moves.size(), numeric_limits<coord_t>::max()); // 放不下时保持最大值
+				if (_batch_traces.size() < _batch_moves.size()) { _batch_traces.resize(_batch_moves.size()); }
+				for_each_worker(_batch_moves.size(), [&](size_t j, MpwBinPack &worker) {
+					const RuleMove &action = _batch_moves[j];
+					worker._bin_height = bin_height;
+					worker._order.assign(picked_rule.sequence, worker._footprints);
+					worker.move_order(action);
+					coord_t target_height;
+					if (worker.decode_loaded(target_height, action.swapped ? base : nullptr, action.a, action.b)) { _batch_heights[j] = target_height; }
+					swap(worker._trace, _batch_traces[j]);
+				});
+
+				size_t best = min_element(_batch_heights.begin(), _batch_heights.end()) - _batch_heights.begin();
+				if (_batch_heights[best] == numeric_limits<coord_t>::max() || _bin_width * _batch_heights[best] >= picked_rule.target_area) { continue; }
+				move_rule(picked_rule, _batch_moves[best]);
+				accept_decoded(picked_rule, _batch_heights[best], _batch_traces[best]);
 			}
-			// б
-			sort(_sort_rules.begin(), _sort_rules.end(), [](const SortRule &lhs, const SortRule &rhs) {
-				return lhs.target_area > rhs.target_area; });
 		}
-		static bool compare(shared_ptr<intermediate_solu> a, shared_ptr<intermediate_solu> b)  //area_percentageԽԽãԴΪʱ֤solutionǰ
+
+		/// rule的sequence解码得到更小的面积，trace为其解码记录，接受后trace被移走
+		void accept_decoded(SortRule &rule, coord_t target_height, DecodeTrace &trace) {
+			rule.target_area = _bin_width * target_height;
+			_visited.test_and_set(rule.visit_key());
+			if (rule.target_area < _obj_area) {
+				_obj_area = rule.target_area;
+				cout << to_string(_obj_area) + "\n"; // 多个求解器并发运行，整行输出
+				_dst = trace.dst;
+				set_bin_height(target_height);
+				update_incumbent(_obj_area);
+			}
+			rule.trace = make_shared<const DecodeTrace>(move(trace));
+		}
+		static bool compare(const intermediate_solu *a, const intermediate_solu *b)  //area_percentage越大越好，以此为依据排序时保证这个大的solution排在前面
 		{
 			return a->area_percentage > b->area_percentage;
 		}
-		static bool compare_byfuture(shared_ptr<intermediate_solu> a, shared_ptr<intermediate_solu> b) 
-		//future_heightԽСԽãԴΪʱ֤Сsolutionǰ		
+		static bool compare_byfuture(const intermediate_solu *a, const intermediate_solu *b) 
+		//future_height越小越好，以此为依据排序时保证这个小的solution排在前面		
 		{
 			return a->future_height < b->future_height;
 		}
-		void insert_bottom_left_score_beam_search(shared_ptr<intermediate_solu> child_solu)
+		/// 按剩余顺序把child_solu放满，返回达到的高度；只读child_solu，可在各线程的求解器副本上并行调用
+		/// dst不为空时把rollout中的放置依次追加进去
+		size_t insert_bottom_left_score_beam_search(const intermediate_solu &child_solu, vector<placement_t> *dst = nullptr)
 		{
-			list<size_t> tmp_polygons = child_solu->polygons;
-			_skyline = child_solu->skyline;
+			PolygonPool &tmp_polygons = _rollout_polygons; //复用上次rollout的空间
+			tmp_polygons = child_solu.polygons;
+			_skyline = child_solu.skyline;
 
 
 			while (!tmp_polygons.empty()) {
-				//ҵ͵skylineiterָskylineָ룬indexvectorе
-				auto bottom_skyline_iter = min_element(_skyline.begin(), _skyline.end(), [](skylinenode_t& lhs, skylinenode_t& rhs) { return lhs.y < rhs.y; });
-				auto best_skyline_index = distance(_skyline.begin(), bottom_skyline_iter);
+				//找到最低的skyline，iter是指向这个skyline的指针，index是在vector中的序号
+				size_t best_skyline_index = _skyline.bottom();
 
-				polygon_ptr best_dst_node;
+				placement_t best_dst_node;
 				size_t best_polygon_index;
 				coord_t best_skyline_height;
 				if (find_polygon_for_skyline_bottom_left_all(best_skyline_index, tmp_polygons, best_dst_node, best_polygon_index, best_skyline_height)) {
-					tmp_polygons.remove(best_polygon_index);
-
-				}
-				else { //  skylineskylineСͬĸ߶
-					if (best_skyline_index == 0) { _skyline[best_skyline_index].y = _skyline[best_skyline_index + 1].y; }
-					else if (best_skyline_index == _skyline.size() - 1) { _skyline[best_skyline_index].y = _skyline[best_skyline_index - 1].y; }
-					else { _skyline[best_skyline_index].y = min(_skyline[best_skyline_index - 1].y, _skyline[best_skyline_index + 1].y); }
-					merge_skylines(_skyline);
+					tmp_polygons.erase(best_polygon_index);
+					if (dst) { dst->push_back(best_dst_node); }
 				}
+				else { fill_pit(best_skyline_index); }
 			}
-			child_solu->future_height =  get_skyline_height();
+			return get_skyline_height();
 		}
 
-		void check_child_solution(shared_ptr<intermediate_solu>& parent_solu, vector<shared_ptr<intermediate_solu>>& child_solu)
+		/// 把试放得到的子代写入slot：skyline为试放后的_skyline，剩余形状为parent_solu的去掉本步放置的形状
+		void store_child(const intermediate_solu &parent_solu, const intermediate_solu &test_solu, intermediate_solu &slot) const {
+			slot.skyline = _skyline;
+			slot.polygons = parent_solu.polygons;
+			if (test_solu.placed) { slot.polygons.erase(test_solu.placement.id); }
+			slot.prefix = test_solu.prefix;
+			slot.placement = test_solu.placement;
+			slot.placed = test_solu.placed;
+			slot.placed_area = test_solu.placed_area;
+			slot.area_percentage = test_solu.area_percentage;
+			slot.current_height = test_solu.current_height;
+			slot.future_height = test_solu.future_height;
+		}
+
+		/// 扩展parent_solu，子代写入slots[0, filter_width)，child_solu按area_percentage从大到小指向其中的子代
+		/// prefix为parent_solu及其祖先的全部放置，由调用者并入前缀树
+		void check_child_solution(const intermediate_solu &parent_solu, const PlacementNode *prefix,
+			intermediate_solu *slots, vector<intermediate_solu *> &child_solu)
 		{
 			child_solu.clear();
 			child_solu.reserve(cfg.filter_width);
 			
-			if (parent_solu->polygons.size() == 0)  //Ѿ
+			if (parent_solu.polygons.size() == 0)  //这个已经放完了
 			{
-				child_solu.push_back(parent_solu);
+				slots[0] = parent_solu;
+				child_solu.push_back(&slots[0]);
 				return;
 			}
 
 
-			intermediate_solu test_solu;
+			intermediate_solu &test_solu = _test_solu; //复用上次扩展的空间，只用其中的放置和面积，skyline和剩余形状在选中时才写入slot
 			
 			std::minstd_rand0 generator(cfg.random_seed);
-			list<size_t>::iterator it = parent_solu->polygons.begin();
+			size_t pos = parent_solu.polygons.find_next(0);
+
+			//各形状都在_skyline上打分并试放，试放后回滚到parent的skyline，当前要放的skyline只需找一次
+			_skyline = parent_solu.skyline;
+			size_t best_skyline_index = _skyline.bottom();
 
 			int cnt = 0;
 		
-			//ͼγ
-			while (it != parent_solu->polygons.end())
+			//逐个图形尝试往里放
+			while (pos != PolygonPool::npos)
 			{
-				
-				test_solu.polygons = parent_solu->polygons;  //ʼstartnodepolygon list
-				test_solu.skyline = parent_solu->skyline;
-				test_solu._dst = parent_solu->_dst;
-				test_solu.current_height = parent_solu->current_height;
-				test_solu.area_percentage = parent_solu->area_percentage;
-
-				size_t no = *it;
+				push_mark();
+				test_solu.prefix = prefix;
+				test_solu.placed = false;
+				test_solu.placed_area = parent_solu.placed_area;
+				test_solu.current_height = parent_solu.current_height;
+				test_solu.area_percentage = parent_solu.area_percentage;
+
+				size_t no = parent_solu.polygons.order().at(pos);
 				
 				
 
-				_skyline = test_solu.skyline;
-
-				//ǰҪŵskyline
-				auto bottom_skyline_iter = min_element(_skyline.begin(), _skyline.end(), [](skylinenode_t& lhs, skylinenode_t& rhs) { return lhs.y < rhs.y; });
-				auto best_skyline_index = distance(_skyline.begin(), bottom_skyline_iter);
-
-				switch (_src.at(no)->shape())
+				switch (_catalog.shape(no))
 				{
 					
 					
 					case Shape::R: {
 				
-						int best_rect_score = -1; // Rʹôֲ
-						auto rect = dynamic_pointer_cast<rect_t>(_src.at(no));
+						int best_rect_score = -1; // R使用打分策略
+						auto rect = _catalog.rect(no);
+						placement_t placement;
 						coord_t x; int rect_score;
-						for (int rotate = 0; rotate <= 1; ++rotate) {            //οת1
+						for (int rotate = 0; rotate <= 1; ++rotate) {            //矩形可以旋转1次
 							coord_t w = rect->width, h = rect->height;
 							if (rotate) { swap(w, h); }
-							if (score_rect_for_skyline_bottom_left(best_skyline_index, w, h, x, rect_score)) {          //
-								if (best_rect_score < rect_score) {       //ԽԽ
+							if (_evaluator.score_rect(_skyline, best_skyline_index, w, h, x, rect_score)) {          //打分
+								if (best_rect_score < rect_score) {       //分越大越好
 									best_rect_score = rect_score;
-									rect->lb_point.x = x;
-									rect->lb_point.y = _skyline[best_skyline_index].y;
-									rect->rotation = rotate ? Rotation::_90_ : Rotation::_0_;
+									placement = placement_t(no, rotate ? Rotation::_90_ : Rotation::_0_, x, _skyline[best_skyline_index].y);
 								}
 							}
 						}
-						if (best_rect_score != -1)  //ܷ
+						if (best_rect_score != -1)  //矩形能放下
 						{
-							auto rect = dynamic_pointer_cast<rect_t>(_src.at(no));
+							auto rect = _catalog.rect(no);
 							coord_t w = rect->width, h = rect->height;
-							if (rect->rotation == Rotation::_90_) { swap(w, h); }
-							skylinenode_t new_skyline_node{ rect->lb_point.x, rect->lb_point.y + h, w };
-							if (rect->lb_point.x == _skyline[best_skyline_index].x) { // 
-								test_solu.skyline.insert(test_solu.skyline.begin() + best_skyline_index, new_skyline_node);
-								test_solu.skyline[best_skyline_index + 1].x += w;
-								test_solu.skyline[best_skyline_index + 1].width -= w;
-								merge_skylines(test_solu.skyline);
-							}
-							else { // 
-								test_solu.skyline.insert(test_solu.skyline.begin() + best_skyline_index + 1, new_skyline_node);
-								test_solu.skyline[best_skyline_index].width -= w;
-								merge_skylines(test_solu.skyline);
-							}
+							if (placement.rotation == Rotation::_90_) { swap(w, h); }
+							skylinenode_t new_skyline_node = skyline_node(placement.x, placement.y + h, w);
+							_skyline.split(best_skyline_index, new_skyline_node); // 靠左或靠右
+							_skyline.merge(best_skyline_index);
 							
 							test_solu.current_height = new_skyline_node.y < test_solu.current_height ? test_solu.current_height : new_skyline_node.y;
-							test_solu._dst.push_back(make_shared<rect_t>(*dynamic_pointer_cast<rect_t>(_src.at(no))));
-							test_solu.polygons.remove(no);
-							//޸area
-							double total_area = 0;
-							for (int i = 0; i < test_solu._dst.size(); ++i)
-							{
-								total_area += test_solu._dst[i]->area;
-							}
-							test_solu.area_percentage = total_area / (test_solu.current_height * _bin_width);
+							test_solu.placement = placement;
+							test_solu.placed = true;
+							//修改area
+							test_solu.placed_area += _catalog.area(no);
+							test_solu.area_percentage = test_solu.placed_area / (test_solu.current_height * _bin_width);
 						}
-						else                        //skylineŲȥ
+						else                        //这个skyline放不进去了
 						{
-							//skyline , 
-							if (best_skyline_index == 0) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index + 1].y; }
-							else if (best_skyline_index == test_solu.skyline.size() - 1) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index - 1].y; }
-							else { test_solu.skyline[best_skyline_index].y = min(test_solu.skyline[best_skyline_index - 1].y, test_solu.skyline[best_skyline_index + 1].y); }
-							merge_skylines(test_solu.skyline);
+							//填充skyline , 填坑
+							fill_pit(best_skyline_index);
 						}
 						break;
 					}
 
 					
-					case Shape::L: {
-				
-						auto lshape = dynamic_pointer_cast<lshape_t>(_src.at(no));
-						skyline_t score_skyline; coord_t score_height; coord_t score_waste;
-						if (score_lshape_for_skyline_bottom_left(0, lshape, score_skyline, score_height, score_waste)) {  //Lܷ
-							test_solu.skyline = score_skyline;
+					case Shape::L: case Shape::T: case Shape::C: {
+						SkylinePatch score_skyline; placement_t placement(no); coord_t score_height; coord_t score_waste;
+						if (_evaluator.score_profiles(_skyline, 0, no, score_skyline, placement, score_height, score_waste)) {  //L/T/C能放下
+							score_skyline.apply(_skyline);
 							//best_skyline_height = best_ltc_height;
 							test_solu.current_height = score_height > test_solu.current_height ? score_height : test_solu.current_height;
-							test_solu._dst.push_back(make_shared<lshape_t>(*dynamic_pointer_cast<lshape_t>(_src.at(no))));
-							test_solu.polygons.remove(no);
-							//޸area
-							double total_area = 0;
-							for (int i = 0; i < test_solu._dst.size(); ++i)
-							{
-								total_area += test_solu._dst[i]->area;
-							}
-							test_solu.area_percentage = total_area / (test_solu.current_height * _bin_width);
+							test_solu.placement = placement;
+							test_solu.placed = true;
+							//修改area
+							test_solu.placed_area += _catalog.area(no);
+							test_solu.area_percentage = test_solu.placed_area / (test_solu.current_height * _bin_width);
 						}
-						else                  //skyline
+						else                  //填充skyline
 						{
-							if (best_skyline_index == 0) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index + 1].y; }
-							else if (best_skyline_index == test_solu.skyline.size() - 1) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index - 1].y; }
-							else { test_solu.skyline[best_skyline_index].y = min(test_solu.skyline[best_skyline_index - 1].y, test_solu.skyline[best_skyline_index + 1].y); }
-							merge_skylines(test_solu.skyline);
-						}
-						break;
-					}
-					case Shape::T: {
-					
-						auto tshape = dynamic_pointer_cast<tshape_t>(_src.at(no));
-						skyline_t score_skyline; coord_t score_height;
-						if (score_tshape_for_skyline_bottom_left(0, tshape, score_skyline, score_height)) {            //Tܷ
-							test_solu.skyline = score_skyline;
-							//best_skyline_height = best_ltc_height;
-							test_solu.current_height = score_height > test_solu.current_height ? score_height : test_solu.current_height;
-							test_solu._dst.push_back(make_shared<tshape_t>(*dynamic_pointer_cast<tshape_t>(_src.at(no))));
-							test_solu.polygons.remove(no);
-							//޸area
-							double total_area = 0;
-							for (int i = 0; i < test_solu._dst.size(); ++i)
-							{
-								total_area += test_solu._dst[i]->area;
-							}
-							test_solu.area_percentage = total_area / (test_solu.current_height * _bin_width);
-						}
-						else                               //skyline
-						{
-							if (best_skyline_index == 0) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index + 1].y; }
-							else if (best_skyline_index == test_solu.skyline.size() - 1) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index - 1].y; }
-							else { test_solu.skyline[best_skyline_index].y = min(test_solu.skyline[best_skyline_index - 1].y, test_solu.skyline[best_skyline_index + 1].y); }
-							merge_skylines(test_solu.skyline);
-						}
-						break;
-					}
-					case Shape::C: {
-					
-						auto concave = dynamic_pointer_cast<concave_t>(_src.at(no));
-						skyline_t score_skyline; coord_t score_height;
-						if (score_concave_for_skyline_bottom_left(0, concave, score_skyline, score_height)) {           //Uܷ
-							test_solu.skyline = score_skyline;
-							//best_skyline_height = best_ltc_height;
-							test_solu.current_height = score_height > test_solu.current_height ? score_height : test_solu.current_height;
-							test_solu._dst.push_back(make_shared<concave_t>(*dynamic_pointer_cast<concave_t>(_src.at(no))));
-							test_solu.polygons.remove(no);
-							//޸area
-							double total_area = 0;
-							for (int i = 0; i < test_solu._dst.size(); ++i)
-							{
-								total_area += test_solu._dst[i]->area;
-							}
-							test_solu.area_percentage = total_area / (test_solu.current_height * _bin_width);
-						}
-						else                                  //skyline
-						{
-							if (best_skyline_index == 0) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index + 1].y; }
-							else if (best_skyline_index == test_solu.skyline.size() - 1) { test_solu.skyline[best_skyline_index].y = test_solu.skyline[best_skyline_index - 1].y; }
-							else { test_solu.skyline[best_skyline_index].y = min(test_solu.skyline[best_skyline_index - 1].y, test_solu.skyline[best_skyline_index + 1].y); }
-							merge_skylines(test_solu.skyline);
+							fill_pit(best_skyline_index);
 						}
 						break;
 					}
@@ -354,10 +538,11 @@ namespace mbp {
 
 				//cout << "percentage" << endl;
 				//cout << test_solu.area_percentage << endl;
-				//area_percentageΪchild_solu滻
+				//以area_percentage为依据在child_solu里面替换
 				if (cnt < cfg.filter_width)
 				{
-					child_solu.push_back(make_shared<intermediate_solu> (test_solu));
+					store_child(parent_solu, test_solu, slots[cnt]);
+					child_solu.push_back(&slots[cnt]);
 
 					if (cnt == cfg.filter_width - 1)
 					{
@@ -365,28 +550,31 @@ namespace mbp {
 					
 					}
 				}
-				else          //Ƿܹ滻parent_solu
+				else          //检查是否能够替换parent_solu
 				{
-					int j = cfg.filter_width - 1;  //Ӻǰ
+					int j = cfg.filter_width - 1;  //从后往前找
 					while (j >= 0 && (child_solu[j]->area_percentage < test_solu.area_percentage || child_solu[j]->area_percentage == test_solu.area_percentage && generator()%2 == 0))
 					{
 						j--;
 					}
-					if (j < cfg.filter_width - 1)  //滻
+					if (j < cfg.filter_width - 1)  //可以替换
 					{
+						intermediate_solu *slot = child_solu[cfg.filter_width - 1]; //被挤出的子代，空间留给test_solu
 						for (int k = cfg.filter_width - 1; k > j + 1; k--)
 						{
 							child_solu[k] = child_solu[k - 1];
 						}
 
-						child_solu[j + 1] = make_shared<intermediate_solu>(test_solu);
+						store_child(parent_solu, test_solu, *slot);
+						child_solu[j + 1] = slot;
 
 					}
 
 				}
 
+				rollback();
 				++cnt;
-				++it;
+				pos = parent_solu.polygons.find_next(pos + 1);
 			}
 			/*cout << "res" << endl;
 			for (int i = 0; i < cfg.filter_width; ++i)
@@ -394,7 +582,7 @@ namespace mbp {
 				cout << child_solu[i]->area_percentage << endl;
 				cout << "dst::" << endl;
 				for (int k = 0; k < child_solu[i]->_dst.size(); k++)
-					cout << child_solu[i]->_dst[k]->id << "  ";
+					cout << child_solu[i]->_dst[k].id << "  ";
 				cout << endl;
 				list<size_t>::iterator tp = child_solu[i]->polygons.begin();
 				cout << "polygon::" << endl;
@@ -407,22 +595,34 @@ namespace mbp {
 			}*/
 		}
 
-		int mbp_based_beamsearch()      //mbp_solverеǰӦضĿ
+		int mbp_based_beamsearch()      //mbp_solver有当前对应的特定的宽度
 		{
-			vector<shared_ptr<intermediate_solu>> parent_solu;    //⣬ÿparentĸbeam_width
+			//中间解存放在两层frontier中交替使用：parent所在的一层只读，子代写入另一层，这时上一代的parent已不再需要
+			//每层固定beam_width*filter_width个中间解，第i个parent的子代占[i*filter_width, (i+1)*filter_width)
+			//中间解对象逐代复用，skyline和PolygonPool的空间也随之复用，扩展和挑选时不再逐个申请和释放
+			vector<intermediate_solu> frontiers[2];
+			frontiers[0].resize(cfg.beam_width * cfg.filter_width);
+			frontiers[1].resize(cfg.beam_width * cfg.filter_width);
+			int parent_frontier = 0;     //parent_solu所在的层
+			deque<PlacementNode> trie;   //放置前缀树，deque追加时已有节点的地址不变
+			vector<const PlacementNode *> prefixes;  //各parent并入前缀树后的前缀
+
+			vector<intermediate_solu *> parent_solu;    //父辈解，每代parent的个数由beam_width决定
 			parent_solu.reserve(cfg.beam_width);
-			vector<vector<shared_ptr<intermediate_solu>>> child_solu(cfg.beam_width);     //ɵľfilterӴ⣬ÿӴbeam_width*filter_width
+			vector<vector<intermediate_solu *>> child_solu(cfg.beam_width);     //父辈解生成的经过filter后的子代解，每代子代解最多有beam_width*filter_width个
 			child_solu.reserve(cfg.beam_width);
-			for (auto child : child_solu)
+			for (auto &child : child_solu)
 			{
 				child.reserve(cfg.filter_width);
 			}
-			shared_ptr<intermediate_solu> start_node;
+			intermediate_solu *start_node = &_test_solu;
 
 			vector<size_t> seq(_src.size());
-			iota(seq.begin(), seq.end(), 0);        //seqΪ˳ 0...N
+			iota(seq.begin(), seq.end(), 0);        //seq为输入顺序 0...N
 			std::minstd_rand0 generator(cfg.random_seed);
 			shuffle(seq.begin(), seq.end(), default_random_engine(cfg.random_seed));
+			PolygonOrder order;     //各中间解共用的放置顺序
+			order.assign(seq, _footprints, &_rect_groups);  //rollout按尺寸分组找精确匹配的矩形
 			int total_area = 0;
 			
 			/*list<size_t>::iterator it = start_node.polygons.begin();
@@ -434,64 +634,52 @@ namespace mbp {
 			}*/
 			
 
-			//һ
-			for (int i = 0; i < seq.size(); ++i)    //ʼһȰÿ״һԣҳfilter_widthռķ÷ʽ
+			//第一轮
+			for (int i = 0; i < seq.size(); ++i)    //最开始一步，先把每个形状都放一遍试试，找出filter_width个空间利用率最大的放置方式
 			{
-				start_node = make_shared<intermediate_solu>();
-				start_node->polygons.assign(seq.begin(), seq.end());  //ʼstartnodepolygon list
+				start_node->polygons.reset(order);  //初始化startnode的polygon list
 				start_node->skyline.clear();
-				start_node->skyline.push_back({ 0,0,_bin_width });
-				start_node->_dst.clear();
-				start_node->_dst.reserve(seq.size());
+				start_node->skyline.push_back(skyline_node(0, 0, _bin_width));
+				start_node->prefix = nullptr;
+				start_node->placed = true;
 
 				
 				
 
 				_skyline = start_node->skyline;
 				
-				switch (_src.at(i)->shape()) {
+				switch (_catalog.shape(i)) {
 
 			
 				case Shape::R: {
-					int best_rect_score = -1; // Rʹôֲ
-					auto rect = dynamic_pointer_cast<rect_t>(_src.at(i));
+					int best_rect_score = -1; // R使用打分策略
+					auto rect = _catalog.rect(i);
+					placement_t placement;
 					coord_t x; int rect_score;
-					for (int rotate = 0; rotate <= 1; ++rotate) {            //οת1
+					for (int rotate = 0; rotate <= 1; ++rotate) {            //矩形可以旋转1次
 						coord_t w = rect->width, h = rect->height;
 						if (rotate) { swap(w, h); }
-						if (score_rect_for_skyline_bottom_left(0, w, h, x, rect_score)) {          //
-							if (best_rect_score < rect_score) {       //ԽԽ
+						if (_evaluator.score_rect(_skyline, 0, w, h, x, rect_score)) {          //打分
+							if (best_rect_score < rect_score) {       //分越大越好
 								best_rect_score = rect_score;
-								rect->lb_point.x = x;
-								rect->lb_point.y = _skyline[0].y;
-								rect->rotation = rotate ? Rotation::_90_ : Rotation::_0_;
+								placement = placement_t(i, rotate ? Rotation::_90_ : Rotation::_0_, x, _skyline[0].y);
 							}
 						}
 					}
-					if (best_rect_score != -1)  //ܷ
+					if (best_rect_score != -1)  //矩形能放下
 					{
-						auto rect = dynamic_pointer_cast<rect_t>(_src.at(i));
+						auto rect = _catalog.rect(i);
 						coord_t w = rect->width, h = rect->height;
-						if (rect->rotation == Rotation::_90_) { swap(w, h); }
-						skylinenode_t new_skyline_node{ rect->lb_point.x, rect->lb_point.y + h, w };
-						if (rect->lb_point.x == start_node->skyline[0].x) { // 
-							start_node->skyline.insert(start_node->skyline.begin(), new_skyline_node);
-							start_node->skyline[1].x += w;
-							start_node->skyline[1].width -= w;
-							
-							merge_skylines(start_node->skyline);
-						}
-						else { // 
-							start_node->skyline.insert(start_node->skyline.begin() + 1, new_skyline_node);
-							start_node->skyline[0].width -= w;
-							merge_skylines(start_node->skyline);
-						}
+						if (placement.rotation == Rotation::_90_) { swap(w, h); }
+						skylinenode_t new_skyline_node = skyline_node(placement.x, placement.y + h, w);
+						start_node->skyline.split(0, new_skyline_node); // 靠左或靠右
+						start_node->skyline.merge(0);
 						//best_rect_height = new_skyline_node.y;
 						//best_skyline_height = best_rect_height;
-						start_node->current_height = new_skyline_node.y;         //еĸ߶
-						start_node->_dst.push_back(make_shared<rect_t>(*dynamic_pointer_cast<rect_t>(_src.at(i))));
+						start_node->current_height = new_skyline_node.y;         //更新现有的高度
+						start_node->placement = placement;
 					}
-					else                        //skyline
+					else                        //填充skyline
 					{
 						assert(false);
 					}
@@ -499,46 +687,15 @@ namespace mbp {
 				}
 
 
-				case Shape::L: {
-					auto lshape = dynamic_pointer_cast<lshape_t>(_src.at(i));
-					skyline_t score_skyline; coord_t score_height; coord_t score_waste;
-					if (score_lshape_for_skyline_bottom_left(0, lshape, score_skyline, score_height, score_waste)) {  //Lܷ
-						start_node->skyline = score_skyline;
-						//best_skyline_height = best_ltc_height;
-						start_node->current_height = score_height;
-						start_node->_dst.push_back(make_shared<lshape_t>(*dynamic_pointer_cast<lshape_t>(_src.at(i))));
-					}
-					else                  //skyline
-					{
-						assert(false);
-					}
-					break;
-				}
-				case Shape::T: {
-					auto tshape = dynamic_pointer_cast<tshape_t>(_src.at(i));
-					skyline_t score_skyline; coord_t score_height;
-					if (score_tshape_for_skyline_bottom_left(0, tshape, score_skyline, score_height)) {            //Tܷ
-						start_node->skyline = score_skyline;
+				case Shape::L: case Shape::T: case Shape::C: {
+					SkylinePatch score_skyline; placement_t placement(i); coord_t score_height; coord_t score_waste;
+					if (_evaluator.score_profiles(_skyline, 0, i, score_skyline, placement, score_height, score_waste)) {  //L/T/C能放下
+						score_skyline.apply(start_node->skyline);
 						//best_skyline_height = best_ltc_height;
 						start_node->current_height = score_height;
-						start_node->_dst.push_back(make_shared<tshape_t>(*dynamic_pointer_cast<tshape_t>(_src.at(i))));
+						start_node->placement = placement;
 					}
-					else                               //skyline
-					{
-						assert(false);
-					}
-					break;
-				}
-				case Shape::C: {
-					auto concave = dynamic_pointer_cast<concave_t>(_src.at(i));
-					skyline_t score_skyline; coord_t score_height;
-					if (score_concave_for_skyline_bottom_left(0, concave, score_skyline, score_height)) {           //Uܷ
-						start_node->skyline = score_skyline;
-						//best_skyline_height = best_ltc_height;
-						start_node->current_height = score_height;
-						start_node->_dst.push_back(make_shared<concave_t>(*dynamic_pointer_cast<concave_t>(_src.at(i))));
-					}
-					else                                  //skyline
+					else                  //填充skyline
 					{
 						assert(false);
 					}
@@ -546,32 +703,36 @@ namespace mbp {
 				}
 				default: { assert(false); break; }
 				}
-				start_node->polygons.remove(i);
-				start_node->area_percentage = (double)_src.at(i)->area / (_bin_width*start_node->current_height);
+				start_node->polygons.erase(i);
+				start_node->placed_area = _catalog.area(i);
+				start_node->area_percentage = start_node->placed_area / (_bin_width*start_node->current_height);
 				if (i < cfg.beam_width)
 				{
-					parent_solu.push_back(start_node);
-					if (i == cfg.beam_width - 1)  //parent_soluˣһ򣬰ЧռȴӴС˳ǰ
+					frontiers[parent_frontier][i] = *start_node;
+					parent_solu.push_back(&frontiers[parent_frontier][i]);
+					if (i == cfg.beam_width - 1)  //parent_solu排满了，进行一次排序，按有效面积占比从大到小的顺序从前往后排
 					{
 						sort(parent_solu.begin(), parent_solu.end(), compare);
 					}
 				}
 
-				else          //Ƿܹ滻parent_solu
+				else          //检查是否能够替换parent_solu
 				{
-					int j = cfg.beam_width - 1;  //Ӻǰ
+					int j = cfg.beam_width - 1;  //从后往前找
 					while (j>=0 && (parent_solu[j]->area_percentage < start_node->area_percentage || parent_solu[j]->area_percentage == start_node->area_percentage && generator() % 2 == 0))
 					{
 						j--;
 					}
-					if (j < cfg.beam_width - 1)  //滻
+					if (j < cfg.beam_width - 1)  //可以替换
 					{
+						intermediate_solu *slot = parent_solu[cfg.beam_width - 1]; //被挤出的parent，空间留给start_node
 						for (int k = cfg.beam_width - 1; k > j + 1; k--)
 						{
 							parent_solu[k] = parent_solu[k - 1];
 						}
 						
-						parent_solu[j + 1] = start_node;
+						*slot = *start_node;
+						parent_solu[j + 1] = slot;
 						
 					}
 
@@ -586,36 +747,88 @@ namespace mbp {
 			bool endflag = true;
 			int cn = 0;
 			int total_best = INT_MAX;
-			//beamsearch
+			intermediate_solu best_leaf;  //达到total_best的子代的拷贝，结束后据此恢复完整的解，frontier中的原件两代后会被覆盖
+			vector<intermediate_solu *> level_children;  //本代所有子代，用于并行rollout
+			vector<size_t> future_heights;
+			vector<size_t> level_slots;           //level_children各自的rollout结果在future_heights中的下标，查表命中时为size_t的最大值
+			vector<size_t> rollout_children;      //各rollout所针对的子代在level_children中的下标，状态相同的子代只rollout第一个
+			vector<uint64_t> rollout_keys;        //各rollout子代的状态键
+			unordered_map<uint64_t, size_t> key_slots;  //本代状态键到rollout下标
+			//后续，beamsearch流程
 			while (true)
 			{
 				++cn;
 				int bestheight = INT_MAX;
-				for (int i = 0; i < cfg.beam_width; ++i)
-				{
-					check_child_solution(parent_solu[i],child_solu[i]);
-					//system("pause");
+				//各parent的扩展相互独立，并行生成子代。check_child_solution每次调用都用cfg.random_seed重新初始化
+				//自己的随机数引擎，每个parent的tie-breaking序列固定，子代与执行线程无关
+				//parent的放置先串行地并入前缀树，各parent的子代共享同一个前缀
+				prefixes.resize(parent_solu.size());
+				for (size_t i = 0; i < parent_solu.size(); ++i) {
+					const intermediate_solu &parent = *parent_solu[i];
+					if (parent.placed) {
+						trie.emplace_back(parent.prefix, parent.placement);
+						prefixes[i] = &trie.back();
+					}
+					else { prefixes[i] = parent.prefix; }
+				}
+				intermediate_solu *child_frontier = frontiers[1 - parent_frontier].data();
+				child_solu.resize(parent_solu.size());
+				for_each_worker(parent_solu.size(), [&](size_t i, MpwBinPack &worker) {
+					worker.check_child_solution(*parent_solu[i], prefixes[i], child_frontier + i * cfg.filter_width, child_solu[i]);
+				});
+
+				//状态相同的子代rollout结果相同：先查置换表，未命中的在同一代中也只rollout第一个，其余沿用它的结果
+				//所有子代都留在beam中参与挑选，挑选结果与逐个rollout时相同
+				level_children.clear(); level_slots.clear(); rollout_children.clear(); rollout_keys.clear(); key_slots.clear();
+				for (auto &children : child_solu) {
+					for (auto &child : children) {
+						uint64_t key = state_key(*child);
+						level_children.push_back(child);
+						size_t future_height;
+						if (_beam_table.find(key, future_height)) {
+							child->future_height = future_height;
+							level_slots.push_back(numeric_limits<size_t>::max());
+							continue;
+						}
+						auto found = key_slots.emplace(key, rollout_children.size());
+						if (found.second) {
+							rollout_children.push_back(level_children.size() - 1);
+							rollout_keys.push_back(key);
+						}
+						else { ++_shared_rollouts; }
+						level_slots.push_back(found.first->second);
+					}
+				}
+
+				//并行rollout，结果先写入future_heights，再按原顺序串行挑选parent，挑选结果与串行版本逐位一致
+				future_heights.resize(rollout_children.size());
+				for_each_worker(rollout_children.size(), [&](size_t k, MpwBinPack &worker) {
+					future_heights[k] = worker.insert_bottom_left_score_beam_search(*level_children[rollout_children[k]]);//计算按剩余顺序放满后的高度
+				});
+				for (size_t k = 0; k < rollout_children.size(); ++k) { _beam_table.insert(rollout_keys[k], future_heights[k]); }
+				for (size_t c = 0; c < level_children.size(); ++c) {
+					if (level_slots[c] != numeric_limits<size_t>::max()) { level_children[c]->future_height = future_heights[level_slots[c]]; }
 				}
 
 				int parentnum = 0;
-				
-				for (int i = 0; i < cfg.beam_width; ++i)
+				parent_solu.resize(cfg.beam_width);
+				for (int i = 0; i < child_solu.size(); ++i)
 				{
 					//cout << child_solu[i].size() << endl;
 					for (int j = 0; j < child_solu[i].size(); ++j)
 					{
 						
-						insert_bottom_left_score_beam_search(child_solu[i][j]);//㰴ʣ˳ĸ߶
 						if (child_solu[i][j]->future_height < bestheight)
 							bestheight = child_solu[i][j]->future_height;
 						if (child_solu[i][j]->future_height < total_best)
 						{
 							total_best = child_solu[i][j]->future_height;
+							best_leaf = *child_solu[i][j];
 						}
 						//cout << child_solu[i][j]->future_height << endl;
-						if (parentnum < cfg.beam_width) //û
+						if (parentnum < cfg.beam_width) //还没放满
 						{
-							//˳parent_solu
+							//按顺序往parent_solu里面放
 							parent_solu[parentnum] = child_solu[i][j];
 							++parentnum;
 							if (parentnum == cfg.beam_width)
@@ -625,13 +838,13 @@ namespace mbp {
 						}
 						else
 						{
-							//Ƚfuture_heightԴΪų
-							int k = cfg.beam_width - 1;  //Ӻǰ
+							//比较future_height，以此为依据排除
+							int k = cfg.beam_width - 1;  //从后往前找
 							while (k >= 0 && (parent_solu[k]->future_height > child_solu[i][j]->future_height || parent_solu[k]->future_height == child_solu[i][j]->future_height && generator() % 2 == 0))
 							{
 								k--;
 							}
-							if (k < cfg.beam_width - 1)  //滻
+							if (k < cfg.beam_width - 1)  //可以替换
 							{
 								for (int m = cfg.beam_width - 1; m > k + 1; m--)
 								{
@@ -645,14 +858,20 @@ namespace mbp {
 					}
 					
 				}
+				if (parentnum < cfg.beam_width) //去重后子代不足beam_width个
+				{
+					parent_solu.resize(parentnum);
+					sort(parent_solu.begin(), parent_solu.end(), compare_byfuture);
+				}
+				parent_frontier = 1 - parent_frontier;
 				
 				//cout << cn << "  loop best: " << bestheight << endl;
 				//system("pause");
-				endflag = true;   //ĬϽ
-				//ѡparent_soluˣΪ
-				for (int i = 0; i < cfg.beam_width; ++i)
+				endflag = true;   //默认结束搜索
+				//选出来的三个parent_solu都放完了，即为结束
+				for (int i = 0; i < parent_solu.size(); ++i)
 				{
-					if (parent_solu[i]->polygons.size() != 0) //һû
+					if (parent_solu[i]->polygons.size() != 0) //还有一个没放完的
 					{
 						endflag = false;
 						break;
@@ -665,139 +884,387 @@ namespace mbp {
 			}
 			
 			//cout << "best: " << total_best << endl;
-			return total_best * _bin_width;
+			//只为最优的子代恢复布局：前缀树中的放置加上重放一遍的rollout
+			collect_placements(best_leaf, _dst);
+			insert_bottom_left_score_beam_search(best_leaf, &_dst);
+			assert(_dst.size() == _catalog.size());
+			_obj_area = total_best * _bin_width;
+			return _obj_area;
 			//system("pause");
 		}
 
-		/// ʹֲԣ̰Ĺһ
-		bool insert_bottom_left_score(vector<polygon_ptr> &dst) {
-			reset();                  //skyline0ʼ
-			dst.clear(); dst.reserve(_polygons.size());
-
+		/// 基于最下最左和打分策略，贪心构造一个完整解
+		/// 从当前的_skyline和_polygons继续解码，各步追加到trace中
+		bool insert_bottom_left_score(DecodeTrace &trace) {
 			while (!_polygons.empty()) {
-				//ҵ͵skylineiterָskylineָ룬indexvectorе
-				auto bottom_skyline_iter = min_element(_skyline.begin(), _skyline.end(), [](skylinenode_t &lhs, skylinenode_t &rhs) { return lhs.y < rhs.y; });
-				auto best_skyline_index = distance(_skyline.begin(), bottom_skyline_iter);
+				++_decoded_steps;
+				//找到最低的skyline，iter是指向这个skyline的指针，index是在vector中的序号
+				size_t best_skyline_index = _skyline.bottom();
 
-				polygon_ptr best_dst_node;
+				placement_t best_dst_node;
 				size_t best_polygon_index;
 				coord_t best_skyline_height;
-				if (find_polygon_for_skyline_bottom_left_all(best_skyline_index, _polygons, best_dst_node, best_polygon_index, best_skyline_height)) {
-					_polygons.remove(best_polygon_index);
-					dst.push_back(best_dst_node);
-					if (best_skyline_height > _bin_height) { return false; } // _bin_height
+				bool found = find_polygon_for_skyline_bottom_left_all(best_skyline_index, _polygons, best_dst_node, best_polygon_index, best_skyline_height, &trace);
+				trace.update_end.push_back(trace.updates.size());
+				trace.tie_group_end.push_back(trace.tie_groups.size());
+				if (found) {
+					_polygons.erase(best_polygon_index);
+					trace.dst.push_back(best_dst_node);
+					if (best_skyline_height > _bin_height) { return false; } // 超出_bin_height
 				}
-				else { //  skylineskylineСͬĸ߶
-					if (best_skyline_index == 0) { _skyline[best_skyline_index].y = _skyline[best_skyline_index + 1].y; }
-					else if (best_skyline_index == _skyline.size() - 1) { _skyline[best_skyline_index].y = _skyline[best_skyline_index - 1].y; }
-					else { _skyline[best_skyline_index].y = min(_skyline[best_skyline_index - 1].y, _skyline[best_skyline_index + 1].y); }
-					merge_skylines(_skyline);
+				else { fill_pit(best_skyline_index); }
+			}
+
+			return true;
+		}
+
+		/// 按sequence的顺序逐个放置，每个块在整条skyline上找放下后最高点最低的位置，其次空隙面积最小，再次最靠左
+		/// 各放置方式的底边轮廓在所有左端位置上的高度和空隙由HeightMap一次算出
+		bool insert_whole_skyline(DecodeTrace &trace) {
+			for (size_t pos = 0; pos < _order.size(); ++pos) {
+				++_decoded_steps;
+				size_t p = _order.at(pos);
+				_height_map.assign(_skyline, _bin_width);
+
+				WholeSkylineFit best;
+				if (_catalog.shape(p) == Shape::R) {
+					const rect_dims_t &rect = *_catalog.rect(p);
+					for (int rotate = 0; rotate < 2; ++rotate) {
+						if (rotate && rect.width == rect.height) { break; }
+						coord_t w = rotate ? rect.height : rect.width, h = rotate ? rect.width : rect.height;
+						WholeSkylineOrientation orientation{ rotate ? Rotation::_90_ : Rotation::_0_, w, h, 0, 0, 1,
+							{ { 0, w, 0 } }, { { w, h } } };
+						fit_whole_skyline(orientation, best);
+					}
 				}
+				else {
+					for (const profile_t *profile = _catalog.profile_begin(p); profile != _catalog.profile_end(p); ++profile) {
+						// 同一旋转的靠左、靠右两种方式底边相同，在整条skyline上只需试一次
+						if (profile != _catalog.profile_begin(p) && profile[-1].rotation == profile->rotation) { continue; }
+						WholeSkylineOrientation orientation{ static_cast<Rotation>(profile->rotation),
+							coord_t(profile->hang_l + profile->mid + profile->hang_r), profile->top, profile->lb_dx, profile->lb_dy, 0, {}, {} };
+						const BottomPart parts[3]{ { 0, profile->hang_l, profile->lift_l },
+							{ profile->hang_l, profile->mid, 0 }, { coord_t(profile->hang_l + profile->mid), profile->hang_r, profile->lift_r } };
+						for (auto &part : parts) {
+							if (part.width > 0) { orientation.parts[orientation.part_num++] = part; }
+						}
+						for (size_t k = 0; k < 3; ++k) { orientation.tops[k] = { profile->tops[k].width, profile->tops[k].height }; }
+						fit_whole_skyline(orientation, best);
+					}
+				}
+				if (!best.found) { return false; } // 宽度上放不下
+
+				place_whole_skyline(best.orientation, best.x, best.base);
+				placement_t placement(p, best.orientation.rotation, 0, 0);
+				placement.set_lb_point(point_t(best.x + best.orientation.lb_dx, best.base + best.orientation.lb_dy));
+				_polygons.erase(p);
+				trace.dst.push_back(placement);
+				if (best.height > _bin_height) { return false; } // 超出_bin_height
 			}
 
 			return true;
 		}
 
+		/// 填坑 将skyline补到与左右两个skyline中最小的同样的高度
+		void fill_pit(size_t skyline_index) {
+			if (skyline_index == 0) { _skyline.raise(skyline_index, _skyline[skyline_index + 1].y); }
+			else if (skyline_index == _skyline.size() - 1) { _skyline.raise(skyline_index, _skyline[skyline_index - 1].y); }
+			else { _skyline.raise(skyline_index, min(_skyline[skyline_index - 1].y, _skyline[skyline_index + 1].y)); }
+			_skyline.merge(skyline_index);
+		}
+
 	private:
+		/// 用orientation在各左端位置上的高度和空隙更新best，比较相同时保留先试的放置方式和更靠左的位置
+		void fit_whole_skyline(const WholeSkylineOrientation &orientation, WholeSkylineFit &best) {
+			size_t count = _height_map.fit(orientation.parts, orientation.part_num, orientation.width);
+			const coord_t *base = _height_map.base(), *gap = _height_map.gap();
+			for (size_t x = 0; x < count; ++x) {
+				coord_t height = base[x] + orientation.top;
+				if (best.found && (height > best.height || (height == best.height && gap[x] >= best.gap))) { continue; }
+				best.found = true;
+				best.orientation = orientation;
+				best.x = static_cast<coord_t>(x);
+				best.base = base[x];
+				best.height = height;
+				best.gap = gap[x];
+			}
+		}
+
+		/// 把形状放在左端x、中段底边base处：[x, x + width)覆盖的节点换成左侧剩余、形状的顶边和右侧剩余
+		void place_whole_skyline(const WholeSkylineOrientation &orientation, coord_t x, coord_t base) {
+			coord_t right = x + orientation.width;
+			size_t first = 0;
+			while (_skyline[first].x + _skyline[first].width <= x) { ++first; }
+			size_t last = first;
+			while (_skyline[last].x + _skyline[last].width < right) { ++last; }
+			const skylinenode_t left = _skyline[first], last_node = _skyline[last];
+
+			skylinenode_t nodes[5];
+			size_t n = 0;
+			if (left.x < x) { nodes[n++] = skyline_node(left.x, left.y, x - left.x); }
+			coord_t node_x = x;
+			for (auto &top : orientation.tops) {
+				if (top.width > 0) { nodes[n++] = skyline_node(node_x, base + top.height, top.width); }
+				node_x += top.width;
+			}
+			assert(node_x == right);
+			if (last_node.x + last_node.width > right) { nodes[n++] = skyline_node(right, last_node.y, last_node.x + last_node.width - right); }
+			_skyline.replace(first, last + 1, nodes, n);
+			_skyline.merge(first + n - 1);
+			_skyline.merge(first);
+		}
+
+		/// 中间解的状态键：同一次beam search中放置顺序固定，skyline和剩余形状都相同的中间解rollout结果相同
+		static uint64_t state_key(const intermediate_solu &solu) { return zobrist_mix(solu.skyline.hash()) ^ solu.polygons.hash(); }
+
+		/// 解码rule得到高度，放不下时返回false，解码过程记录在_trace中
+		bool decode_rule(const SortRule &rule, coord_t &height) {
+			load_sequence(rule.sequence);
+			return decode_loaded(height);
+		}
+
+		/// 解码_order中已载入的sequence，其余同decode_rule
+		/// base不为空时，sequence由base所记录的sequence交换a、b两处得到，先重放选择不变的步再继续解码
+		/// cfg.whole_skyline时按sequence的顺序在整条skyline上放置，不重放base
+		bool decode_loaded(coord_t &height, const DecodeTrace *base = nullptr, size_t a = 0, size_t b = 0) {
+			_polygons.reset(_order);
+			reset();                  //skyline从0开始
+			_trace.clear();
+			if (cfg.whole_skyline) {
+				if (!insert_whole_skyline(_trace)) { return false; }
+			}
+			else {
+				if (base && !replay_unchanged_steps(*base, min(a, b), max(a, b))) { return false; }
+				if (!insert_bottom_left_score(_trace)) { return false; }
+			}
+			height = _trace.height = get_skyline_height();
+			return true;
+		}
+
+		/// 按base依次重放各步，停在第一个选择可能改变的步之前，超出_bin_height时返回false
+		/// 交换只改变a、b(a < b)两处的块：若base在这一步中a、b处都没有更新最优候选，且换到a处的块不优于a之前的最优、
+		/// 换到b处的块不优于b之前的最优，则两个sequence在每个位置上的比较状态都相同，即使LTC的比较不满足传递性，选择也不变
+		bool replay_unchanged_steps(const DecodeTrace &base, size_t a, size_t b) {
+			size_t x = _order.at(b), y = _order.at(a); // base中a、b处的块，交换后分别位于b、a处
+			size_t placed = 0;
+			for (size_t step = 0; step < base.update_end.size(); ++step) {
+				size_t skyline_index = _skyline.bottom();
+				next_score_step();
+				size_t first = step ? base.update_end[step - 1] : 0, last = base.update_end[step];
+				ChoiceKey key_a = BottomLeftChoice().key, key_b = key_a; // a、b之前的最优候选的比较状态
+				for (size_t i = first; i < last; ++i) {
+					const ChoiceUpdate &update = base.updates[i];
+					if (update.pos == a || update.pos == b) { return true; }
+					if (update.pos < a) { key_a = update.key; }
+					if (update.pos < b) { key_b = update.key; }
+				}
+				if (improves_bottom_left_choice(skyline_index, y, key_a) || improves_bottom_left_choice(skyline_index, x, key_b)) { return true; }
+
+				_trace.updates.insert(_trace.updates.end(), base.updates.begin() + first, base.updates.begin() + last);
+				_trace.update_end.push_back(_trace.updates.size());
+				for (size_t i = step ? base.tie_group_end[step - 1] : 0; i < base.tie_group_end[step]; ++i) { // 平局中的块不变，a、b处的块互换了位置
+					typename DecodeTrace::TieGroup group = base.tie_groups[i];
+					size_t begin = _trace.ties.size();
+					for (size_t j = group.begin; j < group.end; ++j) {
+						size_t pos = base.ties[j];
+						_trace.ties.push_back(pos == a ? b : pos == b ? a : pos);
+					}
+					sort(_trace.ties.begin() + begin, _trace.ties.end());
+					group.begin = begin; group.end = _trace.ties.size();
+					_trace.tie_groups.push_back(group);
+				}
+				_trace.tie_group_end.push_back(_trace.tie_groups.size());
+				if (first == last) { fill_pit(skyline_index); continue; }
+
+				// 只给记录中选中的块打分，得到相同的放置
+				const placement_t &recorded = base.dst[placed++];
+				BottomLeftChoice choice; placement_t placement; size_t polygon_index; coord_t skyline_height;
+				offer_bottom_left_candidate(skyline_index, recorded.id, choice);
+				apply_bottom_left_choice(skyline_index, choice, placement, polygon_index, skyline_height);
+				assert(placement.id == recorded.id && placement.x == recorded.x && placement.y == recorded.y);
+				_polygons.erase(polygon_index);
+				_trace.dst.push_back(placement);
+				if (skyline_height > _bin_height) { return false; } // 超出_bin_height
+			}
+			return true;
+		}
+
+		/// 块p放在最下最左的角上是否优于比较状态为key的最优候选，p已放置或宽度上放不下时不参与比较
+		bool improves_bottom_left_choice(size_t skyline_index, size_t p, const ChoiceKey &key) {
+			if (!_polygons.contains(p) || _footprints[p] > _skyline[skyline_index].width) { return false; }
+			BottomLeftChoice choice;
+			choice.key = key;
+			return offer_bottom_left_candidate(skyline_index, p, choice);
+		}
+
+		/// 沿前缀树回溯，按放置顺序恢复solu已做出的全部放置
+		void collect_placements(const intermediate_solu &solu, vector<placement_t> &dst) const {
+			dst.clear();
+			for (const PlacementNode *node = solu.prefix; node; node = node->parent) { dst.push_back(node->placement); }
+			reverse(dst.begin(), dst.end());
+			if (solu.placed) { dst.push_back(solu.placement); }
+		}
+
+		/// 对i取遍[0, n)执行func(i, worker)，worker为当前线程独占的求解器(调用线程使用自身，其余线程使用副本)，
+		/// 其_skyline等解码状态可以随意改写
+		template<typename Func>
+		void for_each_worker(size_t n, Func func) {
+			if (!_pool) {
+				for (size_t i = 0; i < n; ++i) { func(i, *this); }
+				return;
+			}
+			while (_workers.size() < static_cast<size_t>(_pool->size())) {
+				_workers.emplace_back(new MpwBinPack(_src, _catalog, _bin_width, _bin_height, 0));
+			}
+			_pool->parallel_for(n, [&](size_t i, int slot) { func(i, slot ? *_workers[slot - 1] : *this); });
+		}
+
+		/// 以CAS方式把area发布为共享最优面积
+		void update_incumbent(coord_t area) {
+			if (!_incumbent_area) { return; }
+			coord_t curr_area = _incumbent_area->load();
+			while (area < curr_area && !_incumbent_area->compare_exchange_weak(curr_area, area)) {}
+		}
+
+		/// 用共享最优面积收紧_bin_height，其他宽度找到的更优解会立即剪枝本宽度的解码
+		void sync_bin_height() {
+			if (!_incumbent_area) { return; }
+			_bin_height = min(_bin_height, _incumbent_area->load() / _bin_width);
+		}
+
+		/// 按sequence的顺序放入全部多边形
+		void load_sequence(const vector<size_t> &sequence) {
+			_order.assign(sequence, _footprints);
+			_polygons.reset(_order);
+		}
+
 		void reset() {
 			_skyline.clear();
-			_skyline.push_back({ 0,0,_bin_width });
+			_skyline.push_back(skyline_node(0, 0, _bin_width));
 		}
 
 		void init_sort_rules() {
-			// 0_˳
+			// 0_输入顺序
 			vector<size_t> seq(_src.size());
-			iota(seq.begin(), seq.end(), 0);        //seqΪ˳ 0...N
+			iota(seq.begin(), seq.end(), 0);        //seq为输入顺序 0...N
 			_sort_rules.reserve(4);
-			for (size_t i = 0; i < 4; ++i) { _sort_rules.push_back({ seq, numeric_limits<coord_t>::max() }); }   //ʼtarget_areaΪ
-			//_tabu_table.insert((_sort_rules[0].*tabu_key)());
-			// 1_ݼ
+			for (size_t i = 0; i < 4; ++i) { _sort_rules.push_back({ seq, numeric_limits<coord_t>::max(), 0, nullptr }); }   //初始target_area置为无穷大，key在排好序后计算
+			// 1_面积递减
 			sort(_sort_rules[1].sequence.begin(), _sort_rules[1].sequence.end(), [this](size_t lhs, size_t rhs) {
-				return _src.at(lhs)->area > _src.at(rhs)->area; });
-			//_tabu_table.insert((_sort_rules[1].*tabu_key)());
-			// 2_ߵݼ
+				return _catalog.area(lhs) > _catalog.area(rhs); });
+			// 2_最长边递减
 			sort(_sort_rules[2].sequence.begin(), _sort_rules[2].sequence.end(), [this](size_t lhs, size_t rhs) {
 				return _src.at(lhs)->max_length > _src.at(rhs)->max_length; });
-			//_tabu_table.insert((_sort_rules[2].*tabu_key)());
-			// 3_
+			// 3_随机排序
 			shuffle(_sort_rules[3].sequence.begin(), _sort_rules[3].sequence.end(), _gen);
-			//_tabu_table.insert((_sort_rules[3].*tabu_key)());
 
-			// Ĭ˳
-			_polygons.assign(_sort_rules[0].sequence.begin(), _sort_rules[0].sequence.end());
+			for (auto &rule : _sort_rules) { rule.rehash(); }
 
-			// ɢʷֲʼ
+			// 默认输入顺序
+			load_sequence(_sort_rules[0].sequence);
+
+			// 离散概率分布初始化
 			vector<int> probs; probs.reserve(_sort_rules.size());
 			for (int i = 1; i <= _sort_rules.size(); ++i) { probs.push_back(2 * i); }
 			_discrete_dist = discrete_distribution<>(probs.begin(), probs.end());
 		}
 
-		//LINE 181-190:reference sequence
+		//LINE 181-190:更改reference sequence
+
+		/// 邻域动作1：交换两个块的顺序，a、b为交换的位置
+		/// 同一等价类的两个块交换后解码结果不变，不作为邻域动作；只有一个等价类时不再区分
+		/// b先随机重抽至多MaxSwapRetries次，仍不合法时在a所在等价类以外的位置中均匀地挑一个，某个等价类占了大部分块时也不会反复重抽
+		RuleMove random_swap_move(const SortRule &rule) {
+			size_t n = rule.sequence.size();
+			if (n < 2) { return random_rotate_move(); } // 没有可交换的两个位置
+			RuleMove action;
+			action.swapped = true;
+			action.a = _uniform_dist(_gen);
+			action.b = _uniform_dist(_gen);
+			bool by_class = _catalog.class_num() > 1;
+			size_t a_class = _catalog.class_of(rule.sequence[action.a]);
+			auto swappable = [&](size_t b) { return b != action.a && (!by_class || _catalog.class_of(rule.sequence[b]) != a_class); };
+			for (int retry = 0; !swappable(action.b); ++retry) {
+				if (retry == MaxSwapRetries) {
+					size_t candidate_num = by_class ? n - _catalog.class_size(a_class) : n - 1;
+					size_t k = uniform_int_distribution<size_t>(0, candidate_num - 1)(_gen);
+					for (action.b = 0; !swappable(action.b) || k-- > 0; ++action.b) {}
+					break;
+				}
+				action.b = _uniform_dist(_gen);
+			}
+			return action;
+		}
 
-		/// 1˳
-		void swap_sort_rule(SortRule &rule) {
-			size_t a = _uniform_dist(_gen);
-			size_t b = _uniform_dist(_gen);
-			while (a == b) { b = _uniform_dist(_gen); }
-			swap(rule.sequence[a], rule.sequence[b]);
+		/// 邻域动作2：连续多个块移动
+		RuleMove random_rotate_move() {
+			RuleMove action;
+			action.swapped = false;
+			action.a = _uniform_dist(_gen);
+			action.b = 0;
+			return action;
 		}
 
-		/// 2ƶ
-		void rotate_sort_rule(SortRule &rule) {
-			size_t a = _uniform_dist(_gen);
-			rotate(rule.sequence.begin(), rule.sequence.begin() + a, rule.sequence.end());
+		/// 在rule和与之同步的_order上原地执行action
+		void apply_move(SortRule &rule, const RuleMove &action) {
+			move_rule(rule, action);
+			move_order(action);
 		}
 
-		/// ĽѡõĿ
-		bool find_polygon_for_skyline_bottom_left_partial(size_t skyline_index, const list<size_t> &polygons,
-			polygon_ptr &best_dst_node, size_t &best_polygon_index, coord_t &best_skyline_height) {
+		/// 撤销apply_move
+		void undo_move(SortRule &rule, const RuleMove &action) {
+			apply_move(rule, inverse_move(action, rule.sequence.size()));
+		}
+
+		static void move_rule(SortRule &rule, const RuleMove &action) {
+			if (action.swapped) { rule.swap_at(action.a, action.b); }
+			else { rule.rotate_to(action.a); }
+		}
+
+		void move_order(const RuleMove &action) {
+			if (action.swapped) { _order.swap(action.a, action.b); }
+			else { _order.rotate(action.a); }
+		}
+
+		/// action的逆动作：交换再做一次，轮转到原来的首元素
+		static RuleMove inverse_move(const RuleMove &action, size_t n) {
+			if (action.swapped) { return action; }
+			return { false, (n - action.a) % n, 0 };
+		}
+
+		/// 给最下最左的角选择最好的块
+		bool find_polygon_for_skyline_bottom_left_partial(size_t skyline_index, const PolygonPool &polygons,
+			placement_t &best_dst_node, size_t &best_polygon_index, coord_t &best_skyline_height) {
 
 			int best_score = -1;
-			for (size_t p : polygons) {
-				switch (_src.at(p)->shape()) {
+			placement_t placement; // 当前最好的矩形放置方式
+			const uint64_t *fit_mask = polygons.order().fit_mask(_skyline[skyline_index].width); // 只考虑宽度上放得下的块
+			for (size_t pos = polygons.find_next(0, fit_mask); pos != PolygonPool::npos; pos = polygons.find_next(pos + 1, fit_mask)) {
+				size_t p = polygons.order().at(pos);
+				switch (_catalog.shape(p)) {
 				case Shape::R: {
-					auto rect = dynamic_pointer_cast<rect_t>(_src.at(p));
+					auto rect = _catalog.rect(p);
 					coord_t x; int score;
 					for (int rotate = 0; rotate <= 1; ++rotate) {
 						coord_t w = rect->width, h = rect->height;
 						if (rotate) { swap(w, h); }
-						if (score_rect_for_skyline_bottom_left(skyline_index, w, h, x, score)) {
+						if (_evaluator.score_rect(_skyline, skyline_index, w, h, x, score)) {
 							if (best_score < score) {
 								best_score = score;
-								rect->lb_point.x = x;
-								rect->lb_point.y = _skyline[skyline_index].y;
-								rect->rotation = rotate ? Rotation::_90_ : Rotation::_0_;
+								placement = placement_t(p, rotate ? Rotation::_90_ : Rotation::_0_, x, _skyline[skyline_index].y);
 								best_polygon_index = p;
 							}
 						}
 					}
 					break;
 				}
-				case Shape::L: {
-					auto lshape = dynamic_pointer_cast<lshape_t>(_src.at(p));
-					coord_t waste; // no use
-					if (score_lshape_for_skyline_bottom_left(skyline_index, lshape, _skyline, best_skyline_height, waste)) {
+				case Shape::L: case Shape::T: case Shape::C: {
+					SkylinePatch score_skyline; placement_t placement(p); coord_t waste; // no use
+					if (_evaluator.score_profiles(_skyline, skyline_index, p, score_skyline, placement, best_skyline_height, waste)) {
+						score_skyline.apply(_skyline);
 						best_polygon_index = p;
-						best_dst_node = make_shared<lshape_t>(*lshape);
-						return true; // _skylineѱ
-					}
-					break;
-				}
-				case Shape::T: {
-					auto tshape = dynamic_pointer_cast<tshape_t>(_src.at(p));
-					if (score_tshape_for_skyline_bottom_left(skyline_index, tshape, _skyline, best_skyline_height)) {
-						best_polygon_index = p;
-						best_dst_node = make_shared<tshape_t>(*tshape);
-						return true; // _skylineѱ
-					}
-					break;
-				}
-				case Shape::C: {
-					auto concave = dynamic_pointer_cast<concave_t>(_src.at(p));
-					if (score_concave_for_skyline_bottom_left(skyline_index, concave, _skyline, best_skyline_height)) {
-						best_polygon_index = p;
-						best_dst_node = make_shared<concave_t>(*concave);
-						return true; // _skylineѱ
+						best_dst_node = placement;
+						return true; // _skyline已被更新
 					}
 					break;
 				}
@@ -807,711 +1274,310 @@ namespace mbp {
 
 			if (best_score == -1) { return false; }
 
-			// е˴һǾΣ`_skyline``best_skyline_height`
-			assert(_src.at(best_polygon_index)->shape() == Shape::R);
-			auto rect = dynamic_pointer_cast<rect_t>(_src.at(best_polygon_index));
+			// 运行到此处一定是矩形，更新`_skyline`和`best_skyline_height`
+			assert(_catalog.shape(best_polygon_index) == Shape::R);
+			auto rect = _catalog.rect(best_polygon_index);
 			coord_t w = rect->width, h = rect->height;
-			if (rect->rotation == Rotation::_90_) { swap(w, h); }
-			skylinenode_t new_skyline_node{ rect->lb_point.x, rect->lb_point.y + h, w };
-			if (rect->lb_point.x == _skyline[skyline_index].x) { // 
-				_skyline.insert(_skyline.begin() + skyline_index, new_skyline_node);
-				_skyline[skyline_index + 1].x += w;
-				_skyline[skyline_index + 1].width -= w;
-				merge_skylines(_skyline);
-			}
-			else { // 
-				_skyline.insert(_skyline.begin() + skyline_index + 1, new_skyline_node);
-				_skyline[skyline_index].width -= w;
-				merge_skylines(_skyline);
-			}
+			if (placement.rotation == Rotation::_90_) { swap(w, h); }
+			skylinenode_t new_skyline_node = skyline_node(placement.x, placement.y + h, w);
+			_skyline.split(skyline_index, new_skyline_node); // 靠左或靠右
+			_skyline.merge(skyline_index);
 			best_skyline_height = new_skyline_node.y;
-			best_dst_node = make_shared<rect_t>(*rect);
+			best_dst_node = placement;
 			return true;
 		}
 
-		/// ĽѡõĿ
-		bool find_polygon_for_skyline_bottom_left_all(size_t skyline_index, const list<size_t> &polygons,
-			polygon_ptr &best_dst_node, size_t &best_polygon_index, coord_t &best_skyline_height) {
-
-			int best_rect_score = -1; // Rʹôֲ
-			int best_ltc_delta = numeric_limits<int>::max(); // LTCʹskyline.size()仯delta  numeric_limits<int>::max() int͵ֵ
-			coord_t best_l_waste = numeric_limits<coord_t>::max(); // LͬʱʹС˷
-
-			size_t best_rect_index, best_ltc_index;
-			skyline_t best_rect_skyline, best_ltc_skyline;
-			coord_t best_rect_height, best_ltc_height;
-
-			for (size_t p : polygons) {
-				switch (_src.at(p)->shape()) {
-				case Shape::R: {
-					auto rect = dynamic_pointer_cast<rect_t>(_src.at(p));
-					coord_t x; int rect_score;
-					for (int rotate = 0; rotate <= 1; ++rotate) {            //οת1
-						coord_t w = rect->width, h = rect->height;
-						if (rotate) { swap(w, h); }
-						if (score_rect_for_skyline_bottom_left(skyline_index, w, h, x, rect_score)) {          //
-							if (best_rect_score < rect_score) {       //ԽԽ
-								best_rect_score = rect_score;
-								rect->lb_point.x = x;
-								rect->lb_point.y = _skyline[skyline_index].y;
-								rect->rotation = rotate ? Rotation::_90_ : Rotation::_0_;
-								best_rect_index = p;
-							}
-						}
-					}
-					break;
+		/// 给最下最左的角选择最好的块
+		/// trace不为空时按位置依次记录各次更新最优候选后的比较状态，以及这一步中次序会影响选择的位置
+		/// 每一步都在最低的节点上放置或填坑，这个节点随即改变，不会以相同的局部形状再被选为最低，所以不按节点缓存最优候选；
+		/// 按局部形状跨步、跨解码记忆各候选的比较状态也只有一到三成命中，查表的缓存缺失抵消了少打的分，故每步重新打分
+		bool find_polygon_for_skyline_bottom_left_all(size_t skyline_index, const PolygonPool &polygons,
+			placement_t &best_dst_node, size_t &best_polygon_index, coord_t &best_skyline_height, DecodeTrace *trace = nullptr) {
+
+			BottomLeftChoice best;
+			next_score_step();
+			if (trace) { _step_candidates.clear(); }
+			const uint64_t *fit_mask = polygons.order().fit_mask(_skyline[skyline_index].width); // 只考虑宽度上放得下的块
+			int max_rect_score = 7;
+			if (!trace) {
+				max_rect_score = find_top_rect(skyline_index, polygons, best);
+				if (best.key.rect_score == max_rect_score && !ltc_may_win(polygons, fit_mask, _catalog.area(best.rect_index))) {
+					return apply_bottom_left_choice(skyline_index, best, best_dst_node, best_polygon_index, best_skyline_height);
 				}
-				case Shape::L: {
-					auto lshape = dynamic_pointer_cast<lshape_t>(_src.at(p));
-					skyline_t score_skyline; coord_t score_height; coord_t score_waste;
-					if (score_lshape_for_skyline_bottom_left(skyline_index, lshape, score_skyline, score_height, score_waste)) {  //תڴֲ
-						if (best_l_waste > score_waste ||
-							best_l_waste == score_waste && best_ltc_delta > score_skyline.size() - _skyline.size()) {
-							best_l_waste = score_waste;
-							best_ltc_delta = score_skyline.size() - _skyline.size();
-							best_ltc_index = p;
-							best_ltc_skyline = score_skyline;
-							best_ltc_height = score_height;
-						}
-					}
-					break;
-				}
-				case Shape::T: {
-					auto tshape = dynamic_pointer_cast<tshape_t>(_src.at(p));
-					skyline_t score_skyline; coord_t score_height;
-					if (score_tshape_for_skyline_bottom_left(skyline_index, tshape, score_skyline, score_height)) {
-						if (best_ltc_delta > score_skyline.size() - _skyline.size()) {
-							best_ltc_delta = score_skyline.size() - _skyline.size();
-							best_ltc_index = p;
-							best_ltc_skyline = score_skyline;
-							best_ltc_height = score_height;
-						}
-					}
-					break;
-				}
-				case Shape::C: {
-					auto concave = dynamic_pointer_cast<concave_t>(_src.at(p));
-					skyline_t score_skyline; coord_t score_height;
-					if (score_concave_for_skyline_bottom_left(skyline_index, concave, score_skyline, score_height)) {
-						if (best_ltc_delta > score_skyline.size() - _skyline.size()) {
-							best_ltc_delta = score_skyline.size() - _skyline.size();
-							best_ltc_index = p;
-							best_ltc_skyline = score_skyline;
-							best_ltc_height = score_height;
-						}
-					}
-					break;
-				}
-				default: { assert(false); break; }
+			}
+			for (size_t pos = polygons.find_next(0, fit_mask); pos != PolygonPool::npos; pos = polygons.find_next(pos + 1, fit_mask)) {
+				size_t p = polygons.order().at(pos);
+				if (!trace) {
+					// 已达到能达到的最高分，后面的矩形比较相同时不会替换最优
+					if (_catalog.shape(p) != Shape::R || best.key.rect_score < max_rect_score) { offer_bottom_left_candidate(skyline_index, p, best); }
+					continue;
 				}
+				StepCandidate candidate{ pos, _catalog.shape(p), BottomLeftChoice().key };
+				if (offer_bottom_left_candidate(skyline_index, p, best, &candidate.key)) { trace->updates.push_back({ pos, best.key }); }
+				if (candidate.key.rect_score != -1 || candidate.key.ltc_delta != numeric_limits<int>::max()) { _step_candidates.push_back(candidate); }
 			}
+			if (trace) { collect_ties(best.key, *trace); }
+			return apply_bottom_left_choice(skyline_index, best, best_dst_node, best_polygon_index, best_skyline_height);
+		}
 
-			if (best_rect_score == -1) { // RŲ
-				if (best_ltc_delta == numeric_limits<int>::max())  // LTCŲ
-					return false;
-				else  // LTCܷ
-					best_polygon_index = best_ltc_index;
+		/// 记录一步中的平局：R的比较状态只有打分，LTC只有L或只有T/C时按(浪费, 变化量)或变化量比较，都满足传递性，
+		/// 选中的是与最终最优相同的候选中最靠前的；L和T/C同时放得下时T/C的比较不看浪费，不满足传递性，所有LTC候选计为一组
+		void collect_ties(const ChoiceKey &best_key, DecodeTrace &trace) const {
+			bool has_l = false, has_tc = false;
+			for (const StepCandidate &candidate : _step_candidates) {
+				if (candidate.shape == Shape::L) { has_l = true; }
+				else if (candidate.shape != Shape::R) { has_tc = true; }
 			}
-			else { // Rܷ£`best_rect_skyline``best_rect_height`
-				auto rect = dynamic_pointer_cast<rect_t>(_src.at(best_rect_index));
-				coord_t w = rect->width, h = rect->height;
-				if (rect->rotation == Rotation::_90_) { swap(w, h); }
-				best_rect_skyline = _skyline;
-				skylinenode_t new_skyline_node{ rect->lb_point.x, rect->lb_point.y + h, w };
-				if (rect->lb_point.x == best_rect_skyline[skyline_index].x) { // 
-					best_rect_skyline.insert(best_rect_skyline.begin() + skyline_index, new_skyline_node);
-					best_rect_skyline[skyline_index + 1].x += w;  
-					best_rect_skyline[skyline_index + 1].width -= w;
-					merge_skylines(best_rect_skyline);
+			bool any_order = has_l && has_tc;
+			auto push_group = [&](bool any, auto in_group) {
+				size_t begin = trace.ties.size();
+				for (const StepCandidate &candidate : _step_candidates) {
+					if (in_group(candidate)) { trace.ties.push_back(candidate.pos); } // 候选按位置递增
 				}
-				else { // 
-					best_rect_skyline.insert(best_rect_skyline.begin() + skyline_index + 1, new_skyline_node);
-					best_rect_skyline[skyline_index].width -= w;
-					merge_skylines(best_rect_skyline);
-				}
-				best_rect_height = new_skyline_node.y;
+				if (trace.ties.size() - begin > 1) { trace.tie_groups.push_back({ begin, trace.ties.size(), any }); }
+				else { trace.ties.resize(begin); }
+			};
+			push_group(false, [&](const StepCandidate &candidate) {
+				return candidate.shape == Shape::R && candidate.key.rect_score == best_key.rect_score; });
+			push_group(any_order, [&](const StepCandidate &candidate) {
+				if (candidate.shape == Shape::R) { return false; }
+				if (any_order) { return true; }
+				return candidate.key.ltc_delta == best_key.ltc_delta && (candidate.shape != Shape::L || candidate.key.l_waste == best_key.l_waste);
+			});
+		}
 
-				if (best_ltc_delta == numeric_limits<int>::max())  // LTCŲ
-					best_polygon_index = best_rect_index;
-				else // LTCܷ
-					best_polygon_index = _src.at(best_rect_index)->area > _src.at(best_ltc_index)->area ? best_rect_index : best_ltc_index;
-			}
+		using evaluator_t = PlacementEvaluator<Coord>;
+		using SkylineSpace = typename evaluator_t::SkylineSpace;
+		using SkylinePatch = typename evaluator_t::SkylinePatch;
+		using CandidateScore = typename evaluator_t::CandidateScore;
 
-			switch (_src.at(best_polygon_index)->shape()) {
-			case Shape::R:
-				_skyline = best_rect_skyline;
-				best_skyline_height = best_rect_height;
-				best_dst_node = make_shared<rect_t>(*dynamic_pointer_cast<rect_t>(_src.at(best_polygon_index)));
-				break;
-			case Shape::L:
-				_skyline = best_ltc_skyline;
-				best_skyline_height = best_ltc_height;
-				best_dst_node = make_shared<lshape_t>(*dynamic_pointer_cast<lshape_t>(_src.at(best_polygon_index)));
-				break;
-			case Shape::T:
-				_skyline = best_ltc_skyline;
-				best_skyline_height = best_ltc_height;
-				best_dst_node = make_shared<tshape_t>(*dynamic_pointer_cast<tshape_t>(_src.at(best_polygon_index)));
-				break;
-			case Shape::C:
-				_skyline = best_ltc_skyline;
-				best_skyline_height = best_ltc_height;
-				best_dst_node = make_shared<concave_t>(*dynamic_pointer_cast<concave_t>(_src.at(best_polygon_index)));
-				break;
-			default:
-				assert(false);
-				break;
-			}
-			return true;
-		}
+		static skylinenode_t skyline_node(coord_t x, coord_t y, coord_t width) { return evaluator_t::skyline_node(x, y, width); }
+
+		/// 为最下最左的角挑选块时，R和LTC各自的最优候选
+		struct BottomLeftChoice {
+			ChoiceKey key;
+			size_t rect_index, ltc_index;
+			placement_t rect_placement, ltc_placement;
+			SkylinePatch ltc_skyline;
+			coord_t ltc_height;
 
-		/// Space
-		struct SkylineSpace {
-			coord_t x;
-			coord_t y;
-			coord_t width;
-			coord_t hl;
-			coord_t hr;
+			BottomLeftChoice() : key{ -1, numeric_limits<coord_t>::max(), numeric_limits<int>::max() } {}
 		};
 
-		SkylineSpace skyline_nodo_to_space(size_t skyline_index) {          //һspacespacexyǶӦskylinexyspaceĿ
-			coord_t hl, hr;                                                 //hlhrǽԸ߶
-			if (_skyline.size() == 1) {
-				hl = hr = INF - _skyline[skyline_index].y;
-			}
-			else if (skyline_index == 0) {
-				hl = INF - _skyline[skyline_index].y;
-				hr = _skyline[skyline_index + 1].y - _skyline[skyline_index].y;
-			}
-			else if (skyline_index == _skyline.size() - 1) {
-				hl = _skyline[skyline_index - 1].y - _skyline[skyline_index].y;
-				hr = INF - _skyline[skyline_index].y;
-			}
-			else {
-				hl = _skyline[skyline_index - 1].y - _skyline[skyline_index].y;
-				hr = _skyline[skyline_index + 1].y - _skyline[skyline_index].y;
-			}
-			return { _skyline[skyline_index].x, _skyline[skyline_index].y, _skyline[skyline_index].width, hl, hr };
-		}
+		/// 一步中放得下的一个候选，用于找出次序会影响选择的位置
+		struct StepCandidate {
+			size_t pos;
+			Shape shape;
+			ChoiceKey key;
+		};
 
-		/// Rֲ
-		bool score_rect_for_skyline_bottom_left(size_t skyline_index, coord_t width, coord_t height, coord_t &x, int &score) {
-			if (width > _skyline[skyline_index].width) { return false; }
-
-			SkylineSpace space = skyline_nodo_to_space(skyline_index);                 //ȷskylineӦspace
-			if (space.hl >= space.hr) {                                                //ǽ
-				if (width == space.width && height == space.hl) { score = 7; }
-				else if (width == space.width && height == space.hr) { score = 6; }
-				else if (width == space.width && height > space.hl) { score = 5; }
-				else if (width < space.width && height == space.hl) { score = 4; }
-				else if (width == space.width && height < space.hl && height > space.hr) { score = 3; }
-				else if (width < space.width && height == space.hr) { score = 2; } // 
-				else if (width == space.width && height < space.hr) { score = 1; }
-				else if (width < space.width && height != space.hl) { score = 0; }
-				else { return false; }
-
-				if (score == 2) { x = _skyline[skyline_index].x + _skyline[skyline_index].width - width; }  //ҷ
-				else { x = _skyline[skyline_index].x; }
+		/// 块p在当前这一步的打分结果：有多个成员的等价类每步只打一次分，以_score_stamp区分各步；只有一个成员的类直接打分
+		/// 开始新的一步前须调用next_score_step()
+		const CandidateScore &bottom_left_score(size_t skyline_index, size_t p) {
+			size_t c = _catalog.class_of(p);
+			if (_catalog.class_size(c) == 1) {
+				_evaluator.evaluate(_skyline, skyline_index, p, _single_score);
+				return _single_score;
 			}
-			else { // hl < hrǽ
-				if (width == space.width && height == space.hr) { score = 7; }
-				else if (width == space.width && height == space.hl) { score = 6; }
-				else if (width == space.width && height > space.hr) { score = 5; }
-				else if (width < space.width && height == space.hr) { score = 4; } // 
-				else if (width == space.width && height < space.hr && height > space.hl) { score = 3; }
-				else if (width < space.width && height == space.hl) { score = 2; }
-				else if (width == space.width && height < space.hl) { score = 1; }
-				else if (width < space.width && height != space.hr) { score = 0; } // 
-				else { return false; }
-
-				if (score == 4 || score == 0) { x = _skyline[skyline_index].x + _skyline[skyline_index].width - width; } //ҷ
-				else { x = _skyline[skyline_index].x; }
+			if (_class_stamps[c] != _score_stamp) {
+				_class_stamps[c] = _score_stamp;
+				_evaluator.evaluate(_skyline, skyline_index, p, _class_scores[c]);
 			}
-			if (x + width > _bin_width) { return false; }
-
-			return true;
+			return _class_scores[c];
 		}
 
-		/// Lֲ
-		bool score_lshape_for_skyline_bottom_left(size_t skyline_index, lshape_ptr &lshape, skyline_t &skyline, coord_t &skyline_height, coord_t &min_waste) {
-			SkylineSpace space = skyline_nodo_to_space(skyline_index);
-			skyline_t skyline_0l = _skyline, skyline_0r = _skyline,
-				skyline_90 = _skyline, skyline_180 = _skyline,
-				skyline_270l = _skyline, skyline_270r = _skyline;    //skylineĸÿַ÷ʽdelta
-			int min_delta = numeric_limits<int>::max(); 
-			min_waste = numeric_limits<coord_t>::max(); // ˷С
-
-			if (lshape->hd <= space.width) { // 0&
-				// lb_point
-				point_t lb_point_0l = { skyline_0l[skyline_index].x, skyline_0l[skyline_index].y };    //lshapeskylineĿʼλãˣ
-				// update
-				skyline_0l[skyline_index].y += lshape->vl;           //lshape֮󣬵ǰskylineͷֳ֣һhuȣ߶lshapeĸ߶
-				skyline_0l[skyline_index].width = lshape->hu;        //ڶLhm֣lshapeҲʣԭskyline
-				// add
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 1, {              //hm
-					skyline_0l[skyline_index].x + skyline_0l[skyline_index].width,
-					skyline_0l[skyline_index].y - lshape->vm,
-					lshape->hm });
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 2, {              //skylineʣಿ
-					skyline_0l[skyline_index + 1].x + skyline_0l[skyline_index + 1].width,
-					skyline_0l[skyline_index + 1].y - lshape->vr,
-					space.width - lshape->hd });
-				// merge
-				coord_t skyline_height_bk = skyline_0l[skyline_index].y;  // ֹmergeskyline_indexʧЧ
-				merge_skylines(skyline_0l);
-				// delta
-				if (min_delta > skyline_0l.size() - _skyline.size()) {       //deltaӵskylineԽСԽ
-					min_delta = skyline_0l.size() - _skyline.size();
-					min_waste = 0;
-					lshape->rotation = Rotation::_0_;
-					lshape->lb_point = lb_point_0l;
-					skyline = skyline_0l;
-					skyline_height = skyline_height_bk;       //skyline_height˼Ƿlshapelshapeȫֵ߸߶ȣһе߸߶
-				}
-			}
-
-			if (lshape->hd < space.width) { // 0&
-				// lb_point
-				point_t lb_point_0r = { skyline_0r[skyline_index].x + space.width - lshape->hd, skyline_0r[skyline_index].y };  //ҷõĲο
-				// update
-				skyline_0r[skyline_index].width -= lshape->hd;         //ԭskylineһ
-				// add
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 1, {
-					skyline_0r[skyline_index].x + skyline_0r[skyline_index].width,   //lshapeĶhu
-					skyline_0r[skyline_index].y + lshape->vl,
-					lshape->hu });
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 2, {
-					skyline_0r[skyline_index + 1].x + skyline_0r[skyline_index + 1].width,  //lshapeм䣬hm
-					skyline_0r[skyline_index + 1].y - lshape->vm,
-					lshape->hm });
-				// merge
-				coord_t skyline_height_bk = skyline_0r[skyline_index + 1].y;  //úlshapeߵ
-				merge_skylines(skyline_0r);                                    //skyline
-				// delta
-				if (min_delta > skyline_0r.size() - _skyline.size()) {
-					min_delta = skyline_0r.size() - _skyline.size();
-					min_waste = 0;
-					lshape->rotation = Rotation::_0_;
-					lshape->lb_point = lb_point_0r;
-					skyline = skyline_0r;
-					skyline_height = skyline_height_bk;
+		void next_score_step() { ++_score_stamp; }
+
+		/// 给最下最左的角上的候选p打分，比best更好时更新best，返回是否更新
+		/// own不为空时写入p自身的比较状态，R为两种旋转中较高的打分
+		/// 同一等价类的块打分相同，但仍逐个参与比较，LTC的比较不满足传递性，跳过后面的成员可能改变选择
+		bool offer_bottom_left_candidate(size_t skyline_index, size_t p, BottomLeftChoice &best, ChoiceKey *own = nullptr) {
+			const CandidateScore &score = bottom_left_score(skyline_index, p);
+			bool updated = false;
+			switch (_catalog.shape(p)) {
+			case Shape::R: {
+				for (int rotate = 0; rotate <= 1; ++rotate) {
+					if (!score.rect_fit[rotate]) { continue; }
+					int rect_score = score.rect_score[rotate];
+					if (own) { own->rect_score = max(own->rect_score, rect_score); }
+					if (best.key.rect_score < rect_score) {       //分越大越好
+						best.key.rect_score = rect_score;
+						best.rect_placement = placement_t(p, rotate ? Rotation::_90_ : Rotation::_0_, score.rect_x[rotate], _skyline[skyline_index].y);
+						best.rect_index = p;
+						updated = true;
+					}
 				}
+				break;
 			}
-
-			if (lshape->vl <= space.width) { // 270&
-				// lb_point
-				point_t lb_point_270l = { skyline_270l[skyline_index].x + lshape->vl, skyline_270l[skyline_index].y }; //ολ
-				// update
-				skyline_270l[skyline_index].y += lshape->hu;
-				skyline_270l[skyline_index].width = lshape->vm;
-				// add
-				skyline_270l.insert(skyline_270l.begin() + skyline_index + 1, {
-					skyline_270l[skyline_index].x + skyline_270l[skyline_index].width,
-					skyline_270l[skyline_index].y + lshape->hm,
-					lshape->vr });
-				skyline_270l.insert(skyline_270l.begin() + skyline_index + 2, {
-					skyline_270l[skyline_index + 1].x + skyline_270l[skyline_index + 1].width,
-					skyline_270l[skyline_index + 1].y - lshape->hd,
-					space.width - lshape->vl });
-				// merge
-				coord_t skyline_height_bk = skyline_270l[skyline_index + 1].y;   //úlshapeߵ
-				merge_skylines(skyline_270l);
-				// delta
-				if (min_delta > skyline_270l.size() - _skyline.size()) {
-					min_delta = skyline_270l.size() - _skyline.size();
-					min_waste = 0;                                           //waste
-					lshape->rotation = Rotation::_270_;
-					lshape->lb_point = lb_point_270l;
-					skyline = skyline_270l;
-					skyline_height = skyline_height_bk;
+			case Shape::L: {
+				if (score.ltc_fit) {
+					size_t ltc_delta = score.ltc_skyline.size() - _skyline.size(); // 与score_profiles相同，按无符号数比较
+					if (own) { own->l_waste = score.ltc_waste; own->ltc_delta = int(ltc_delta); }
+					if (best.key.l_waste > score.ltc_waste ||
+						(best.key.l_waste == score.ltc_waste && size_t(best.key.ltc_delta) > ltc_delta)) {
+						best.key.l_waste = score.ltc_waste;
+						best.key.ltc_delta = int(ltc_delta);
+						take_ltc_score(p, score, best);
+						updated = true;
+					}
 				}
+				break;
 			}
-
-			if (lshape->vl < space.width) { // 270&
-				// lb_point
-				point_t lb_point_270r = { skyline_270r[skyline_index].x + space.width, skyline_270r[skyline_index].y }; //οskylineҶ
-				// update
-				skyline_270r[skyline_index].width -= lshape->vl;
-				// add
-				skyline_270r.insert(skyline_270r.begin() + skyline_index + 1, {
-					skyline_270r[skyline_index].x + skyline_270r[skyline_index].width,
-					skyline_270r[skyline_index].y + lshape->hu,
-					lshape->vm });
-				skyline_270r.insert(skyline_270r.begin() + skyline_index + 2, {
-					skyline_270r[skyline_index + 1].x + skyline_270r[skyline_index + 1].width,
-					skyline_270r[skyline_index + 1].y + lshape->hm,
-					lshape->vr });
-				// merge
-				coord_t skyline_height_bk = skyline_270r[skyline_index + 2].y;
-				merge_skylines(skyline_270r);
-				// delta
-				if (min_delta > skyline_270r.size() - _skyline.size()) {
-					min_delta = skyline_270r.size() - _skyline.size();
-					min_waste = 0;
-					lshape->rotation = Rotation::_270_;
-					lshape->lb_point = lb_point_270r;
-					skyline = skyline_270r;
-					skyline_height = skyline_height_bk;
+			case Shape::T: case Shape::C: {   // T和C比较变化量
+				if (score.ltc_fit) {
+					size_t ltc_delta = score.ltc_skyline.size() - _skyline.size();
+					if (own) { own->ltc_delta = int(ltc_delta); }
+					if (size_t(best.key.ltc_delta) > ltc_delta) {
+						best.key.ltc_delta = int(ltc_delta);
+						take_ltc_score(p, score, best);
+						updated = true;
+					}
 				}
+				break;
 			}
-			//ת90ֻܽҲ
-			if (skyline_index + 1 < skyline_90.size()  //Ҳ໹skyline
-				&& lshape->vm <= skyline_90[skyline_index + 1].width   //Ҳskylineĳܹlshapeȥ
-				//&& lshape->hm == space.hr // עͣ˷
-				&& lshape->vr <= space.width) {                        //мĿռlshapeǶȥ
-				coord_t new_skyline_height = max(lshape->hd, lshape->hu + space.hr);   //Ҳ಻һȫӣмܴڿ϶ heightspaceӦskylineĸ߶
-				// lb_point  Ҳ
-				point_t lb_point_90 = { skyline_90[skyline_index].x + space.width - lshape->vr, skyline_90[skyline_index].y + new_skyline_height };
-				// update
-				skyline_90[skyline_index].width -= lshape->vr;
-				// add
-				skyline_90.insert(skyline_90.begin() + skyline_index + 1, {
-					skyline_90[skyline_index].x + skyline_90[skyline_index].width,
-					skyline_90[skyline_index].y + new_skyline_height,
-					lshape->vl });
-				// delete right  ޸ԭspaceҲskyline
-				skyline_90[skyline_index + 2].x += lshape->vm;
-				skyline_90[skyline_index + 2].width -= lshape->vm;
-				// merge
-				coord_t skyline_height_bk = skyline_90[skyline_index + 1].y;
-				merge_skylines(skyline_90);
-				// waste
-				//coord_t old_space = min(space.hl, space.hr) * space.width;
-				//coord_t new_space = min(space.hl, new_skyline_height) * skyline_90[skyline_index].width;
-				coord_t waste_90 = lshape->hd > lshape->hu + space.hr ?
-					(lshape->hd - lshape->hu - space.hr) * lshape->vm : // Ϸ˷  ԭskylineҲ˷
-					(lshape->hu + space.hr - lshape->hd) * lshape->vr;  // ·˷  lshapevr߹skylineı
-				// delta
-				if (min_waste > waste_90 ||         //ԽСԽ
-					min_waste == waste_90 && min_delta > skyline_90.size() - _skyline.size()) {
-					min_waste = waste_90;
-					min_delta = skyline_90.size() - _skyline.size();
-					lshape->rotation = Rotation::_90_;
-					lshape->lb_point = lb_point_90;
-					skyline = skyline_90;
-					skyline_height = skyline_height_bk;
-				}
+			default: { assert(false); break; }
 			}
+			return updated;
+		}
 
-			if (skyline_index >= 1        //Ҫ
-				&& lshape->hm <= skyline_180[skyline_index - 1].width   //תlshapeߵĲֲߵskyline
-				//&& lshape->vm == space.hl // עͣ˷
-				&& lshape->hu <= space.width) {
-				coord_t new_skyline_height = max(lshape->vl, lshape->vr + space.hl);   //ڵskylineĸ߶
-				// lb_point
-				point_t lb_point_180 = { skyline_180[skyline_index].x + lshape->hu, skyline_180[skyline_index].y + new_skyline_height };
-				// update
-				skyline_180[skyline_index].x -= lshape->hm;
-				skyline_180[skyline_index].y += new_skyline_height;  //lshapeת180Ⱥ˵ı
-				skyline_180[skyline_index].width = lshape->hd;
-				// add
-				skyline_180.insert(skyline_180.begin() + skyline_index + 1, {
-					skyline_180[skyline_index].x + skyline_180[skyline_index].width,         //ԭskylineʣĲ
-					skyline_180[skyline_index].y - new_skyline_height,
-					space.width - lshape->hu });
-				// delete left
-				skyline_180[skyline_index - 1].width -= lshape->hm;         //skyline޸
-				// merge
-				coord_t skyline_height_bk = skyline_180[skyline_index].y;
-				merge_skylines(skyline_180);
-				// waste
-				//coord_t old_space = min(space.hl, space.hr) * space.width;
-				//coord_t new_space = min(space.hr, new_skyline_height) * skyline_180[skyline_index + 1].width;
-				coord_t waste_180 = lshape->vl > lshape->vr + space.hl ?
-					(lshape->vl - lshape->vr - space.hl) * lshape->hm :   //ײ˷
-					(lshape->vr + space.hl - lshape->vl) * lshape->hu;
-				// delta
-				if (min_waste > waste_180 ||
-					min_waste == waste_180 && min_delta > skyline_180.size() - _skyline.size()) {
-					min_waste = waste_180;
-					min_delta = skyline_180.size() - _skyline.size();
-					lshape->rotation = Rotation::_180_;
-					lshape->lb_point = lb_point_180;
-					skyline = skyline_180;
-					skyline_height = skyline_height_bk;
-				}
-			}
+		/// 以块p和它的打分结果作为LTC的最优候选
+		static void take_ltc_score(size_t p, const CandidateScore &score, BottomLeftChoice &best) {
+			best.ltc_index = p;
+			best.ltc_skyline = score.ltc_skyline;
+			best.ltc_height = score.ltc_height;
+			best.ltc_placement = score.ltc_placement;
+			best.ltc_placement.id = static_cast<uint32_t>(p);
+		}
 
-			if (min_delta == numeric_limits<int>::max()) { return false; }
-			return true;
+		/// 用精确匹配索引找打分为7或6的矩形：宽度等于当前节点的宽度、高度等于较高或较低的墙，按位置最靠前的一个写入best
+		/// 返回矩形在这一步能达到的最高分，找到时即为其打分，否则为5；跳过的矩形不再逐个打分
+		/// 只在不记录trace时使用，即beam search的rollout；RLS解码要为重放记录每个候选的比较状态，仍逐个打分，不使用该索引
+		int find_top_rect(size_t skyline_index, const PolygonPool &polygons, BottomLeftChoice &best) const {
+			SkylineSpace space = evaluator_t::skyline_nodo_to_space(_skyline, skyline_index);
+			coord_t high = max(space.hl, space.hr), low = min(space.hl, space.hr);
+			size_t pos; Rotation rotation; int score;
+			if (find_exact_rect(polygons, space.width, high, pos, rotation)) { score = 7; }
+			else if (low != high && find_exact_rect(polygons, space.width, low, pos, rotation)) { score = 6; } // 两墙等高时都计为7
+			else { return 5; }
+			size_t p = polygons.order().at(pos);
+			best.key.rect_score = score;
+			best.rect_placement = placement_t(p, rotation, space.x, space.y);
+			best.rect_index = p;
+			return score;
 		}
 
-		/// Tֲ   תʱǵTͣο½
-		bool score_tshape_for_skyline_bottom_left(size_t skyline_index, tshape_ptr &tshape, skyline_t &skyline, coord_t &skyline_height) {
-			SkylineSpace space = skyline_nodo_to_space(skyline_index);
-			skyline_t skyline_0l = _skyline, skyline_0r = _skyline,
-				skyline_90 = _skyline, skyline_180 = _skyline, skyline_270 = _skyline;
-			int min_delta = numeric_limits<int>::max();
-
-			if (tshape->hd <= space.width) { // 0&
-				// lb_point
-				point_t lb_point_0l = { skyline_0l[skyline_index].x, skyline_0l[skyline_index].y };  //οskylineʼغ
-				// update
-				skyline_0l[skyline_index].y += tshape->vld;
-				skyline_0l[skyline_index].width = tshape->hl;
-				// add
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 1, {
-					skyline_0l[skyline_index].x + skyline_0l[skyline_index].width,   //T
-					skyline_0l[skyline_index].y + tshape->vlu,
-					tshape->hu });
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 2, {
-					skyline_0l[skyline_index + 1].x + skyline_0l[skyline_index + 1].width,  //ڵTҲƽ
-					skyline_0l[skyline_index + 1].y - tshape->vru,
-					tshape->hr });
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 3, {
-					skyline_0l[skyline_index + 2].x + skyline_0l[skyline_index + 2].width,  //ԭskylineʣ
-					skyline_0l[skyline_index + 2].y - tshape->vrd,
-					space.width - tshape->hd });
-				// merge
-				coord_t skyline_height_bk = skyline_0l[skyline_index + 1].y;
-				merge_skylines(skyline_0l);
-				// delta
-				if (min_delta > skyline_0l.size() - _skyline.size()) {
-					min_delta = skyline_0l.size() - _skyline.size();
-					tshape->rotation = Rotation::_0_;
-					tshape->lb_point = lb_point_0l;
-					skyline = skyline_0l;
-					skyline_height = skyline_height_bk;
-				}
-			}
+		/// 剩余的矩形中旋转后为width * height的位置最靠前的一个，先旋转0再旋转90，正方形只按旋转0
+		/// 同尺寸的矩形在polygons.order()中有各自的分组掩码，按位找第一个剩余的位置，代价与块数/64成正比，与同尺寸的矩形数无关
+		bool find_exact_rect(const PolygonPool &polygons, coord_t width, coord_t height, size_t &best_pos, Rotation &rotation) const {
+			best_pos = PolygonPool::npos;
+			auto scan = [&](coord_t w, coord_t h, Rotation r) {
+				auto bucket = _rect_index.find(dims_key(w, h));
+				if (bucket == _rect_index.end()) { return; }
+				size_t pos = polygons.find_next(0, polygons.order().group_mask(bucket->second));
+				if (pos < best_pos) { best_pos = pos; rotation = r; }
+			};
+			scan(width, height, Rotation::_0_);
+			if (width != height) { scan(height, width, Rotation::_90_); }
+			return best_pos != PolygonPool::npos;
+		}
 
-			if (tshape->hd < space.width) { // 0&
-				// lb_point
-				point_t lb_point_0r = { skyline_0r[skyline_index].x + space.width - tshape->hd, skyline_0r[skyline_index].y };
-				// update
-				skyline_0r[skyline_index].width -= tshape->hd;
-				// add  ¼tshapeskyline
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 1, {
-					skyline_0r[skyline_index].x + skyline_0r[skyline_index].width,
-					skyline_0r[skyline_index].y + tshape->vld,
-					tshape->hl });
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 2, {
-					skyline_0r[skyline_index + 1].x + skyline_0r[skyline_index + 1].width,
-					skyline_0r[skyline_index + 1].y + tshape->vlu,
-					tshape->hu });
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 3, {
-					skyline_0r[skyline_index + 2].x + skyline_0r[skyline_index + 2].width,
-					skyline_0r[skyline_index + 2].y - tshape->vru,
-					tshape->hr });
-				// merge
-				coord_t skyline_height_bk = skyline_0r[skyline_index + 2].y;
-				merge_skylines(skyline_0r);
-				// delta
-				if (min_delta > skyline_0r.size() - _skyline.size()) {
-					min_delta = skyline_0r.size() - _skyline.size();
-					tshape->rotation = Rotation::_0_;
-					tshape->lb_point = lb_point_0r;
-					skyline = skyline_0r;
-					skyline_height = skyline_height_bk;
-				}
+		/// 是否有放得下的L/T/C面积不小于area：最终在R和LTC的最优候选中取面积较大的，矩形面积更大时LTC不必打分
+		bool ltc_may_win(const PolygonPool &polygons, const uint64_t *fit_mask, coord_t area) const {
+			for (size_t pos = polygons.find_next(0, fit_mask); pos != PolygonPool::npos; pos = polygons.find_next(pos + 1, fit_mask)) {
+				size_t p = polygons.order().at(pos);
+				if (_catalog.shape(p) != Shape::R && _catalog.area(p) >= area) { return true; }
 			}
+			return false;
+		}
 
-			if (skyline_index + 1 < skyline_90.size()  //˳ʱת90ҲҪ
-				&& tshape->vru <= skyline_90[skyline_index + 1].width   //vruҲ
-				&& tshape->hr == space.hr    //Ҳܴ
-				&& tshape->vrd <= space.width) {          //ײռ㹻
-				// lb_point
-				point_t lb_point_90 = { skyline_90[skyline_index].x + space.width - tshape->vrd, skyline_90[skyline_index].y + tshape->hd };
-				// update
-				skyline_90[skyline_index].width -= tshape->vrd;
-				// add
-				skyline_90.insert(skyline_90.begin() + skyline_index + 1, {
-					skyline_90[skyline_index].x + skyline_90[skyline_index].width,
-					skyline_90[skyline_index].y + tshape->hd,
-					tshape->vld });
-				skyline_90.insert(skyline_90.begin() + skyline_index + 2, {
-					skyline_90[skyline_index + 1].x + skyline_90[skyline_index + 1].width,
-					skyline_90[skyline_index + 1].y - tshape->hl,
-					tshape->vlu });
-				// delete right
-				skyline_90[skyline_index + 3].x += tshape->vru;
-				skyline_90[skyline_index + 3].width -= tshape->vru;
-				// merge
-				coord_t skyline_height_bk = skyline_90[skyline_index + 1].y;
-				merge_skylines(skyline_90);
-				// delta
-				if (min_delta > skyline_90.size() - _skyline.size()) {
-					min_delta = skyline_90.size() - _skyline.size();
-					tshape->rotation = Rotation::_90_;
-					tshape->lb_point = lb_point_90;
-					skyline = skyline_90;
-					skyline_height = skyline_height_bk;
-				}
-			}
+		static uint64_t dims_key(coord_t width, coord_t height) { return uint64_t(uint32_t(width)) << 32 | uint32_t(height); }
 
-			if (skyline_index + 1 < skyline_180.size() && skyline_index >= 1  //ת180TͣҶҪskyline
-				&& tshape->hl <= skyline_180[skyline_index + 1].width
-				&& tshape->hr <= skyline_180[skyline_index - 1].width   //Ҷ
-				&& tshape->vlu == space.hr
-				&& tshape->vru == space.hl                                //
-				&& tshape->hu == space.width) {                         //ײǶ
-				// lb_point
-				point_t lb_point_180 = { skyline_180[skyline_index].x + tshape->hu + tshape->hl, skyline_180[skyline_index].y + tshape->vlu + tshape->vld };
-				// update
-				skyline_180[skyline_index].x -= tshape->hr;
-				skyline_180[skyline_index].y += (tshape->vru + tshape->vrd);
-				skyline_180[skyline_index].width = tshape->hd;
-				// delete left
-				skyline_180[skyline_index - 1].width -= tshape->hr;
-				// delete right
-				skyline_180[skyline_index + 1].x += tshape->hl;
-				skyline_180[skyline_index + 1].width -= tshape->hl;
-				// merge
-				coord_t skyline_height_bk = skyline_180[skyline_index].y;
-				merge_skylines(skyline_180);
-				// delta
-				if (min_delta > skyline_180.size() - _skyline.size()) {
-					min_delta = skyline_180.size() - _skyline.size();
-					tshape->rotation = Rotation::_180_;
-					tshape->lb_point = lb_point_180;
-					skyline = skyline_180;
-					skyline_height = skyline_height_bk;
-				}
-			}
+		/// 在R和LTC各自的最优候选中选出最终放置的块并写回_skyline，都放不下时返回false
+		bool apply_bottom_left_choice(size_t skyline_index, const BottomLeftChoice &best,
+			placement_t &best_dst_node, size_t &best_polygon_index, coord_t &best_skyline_height) {
 
-			if (skyline_index >= 1                               //˳ʱ27090
-				&& tshape->vlu <= skyline_270[skyline_index - 1].width
-				&& tshape->hl == space.hl
-				&& tshape->vld <= space.width) {    //ײ㹻
-				// lb_point
-				point_t lb_point_270 = { skyline_270[skyline_index].x + tshape->vld, skyline_270[skyline_index].y };
-				// update
-				skyline_270[skyline_index].x -= tshape->vlu;
-				skyline_270[skyline_index].y += (tshape->hl + tshape->hu);
-				skyline_270[skyline_index].width = tshape->vru;
-				// add
-				skyline_270.insert(skyline_270.begin() + skyline_index + 1, {
-					skyline_270[skyline_index].x + skyline_270[skyline_index].width,
-					skyline_270[skyline_index].y + tshape->hr,
-					tshape->vrd });
-				skyline_270.insert(skyline_270.begin() + skyline_index + 2, {
-					skyline_270[skyline_index + 1].x + skyline_270[skyline_index + 1].width,
-					skyline_270[skyline_index + 1].y - tshape->hd,
-					space.width - tshape->vld });
-				// delete left
-				skyline_270[skyline_index - 1].width -= tshape->vlu;
-				// merge
-				coord_t skyline_height_bk = skyline_270[skyline_index + 1].y;
-				merge_skylines(skyline_270);
-				// delta
-				if (min_delta > skyline_270.size() - _skyline.size()) {
-					min_delta = skyline_270.size() - _skyline.size();
-					tshape->rotation = Rotation::_270_;
-					tshape->lb_point = lb_point_270;
-					skyline = skyline_270;
-					skyline_height = skyline_height_bk;
-				}
+			SkylinePatch best_rect_skyline;
+			coord_t best_rect_height = numeric_limits<coord_t>::max();
+			if (best.key.rect_score == -1) { // R放不下
+				if (best.key.ltc_delta == numeric_limits<int>::max())  // LTC放不下
+					return false;
+				else  // LTC能放下
+					best_polygon_index = best.ltc_index;
 			}
+			else { // R能放下，计算`best_rect_skyline`和`best_rect_height`
+				best_rect_height = _evaluator.place_rect(_skyline, skyline_index, best.rect_placement, best_rect_skyline);
 
-			if (min_delta == numeric_limits<int>::max()) { return false; }
-			return true;
-		}
-
-		/// Cֲ
-		bool score_concave_for_skyline_bottom_left(size_t skyline_index, concave_ptr &concave, skyline_t &skyline, coord_t &skyline_height) {
-			SkylineSpace space = skyline_nodo_to_space(skyline_index);
-			skyline_t skyline_0l = _skyline, skyline_0r = _skyline;
-			int min_delta = numeric_limits<int>::max();
-
-			if (concave->hd <= space.width) { // 0&
-				// lb_point
-				point_t lb_point_0l = { skyline_0l[skyline_index].x, skyline_0l[skyline_index].y };  //οU͵½
-				// update
-				skyline_0l[skyline_index].y += concave->vld;
-				skyline_0l[skyline_index].width = concave->hl;
-				// add
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 1, {
-					skyline_0l[skyline_index].x + skyline_0l[skyline_index].width,
-					skyline_0l[skyline_index].y - concave->vlu,
-					concave->hu });
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 2, {
-					skyline_0l[skyline_index + 1].x + skyline_0l[skyline_index + 1].width,
-					skyline_0l[skyline_index + 1].y + concave->vru,
-					concave->hr });
-				skyline_0l.insert(skyline_0l.begin() + skyline_index + 3, {
-					skyline_0l[skyline_index + 2].x + skyline_0l[skyline_index + 2].width,
-					skyline_0l[skyline_index + 2].y - concave->vrd,
-					space.width - concave->hd });
-				// merge
-				coord_t skyline_height_bk = max(skyline_0l[skyline_index].y, skyline_0l[skyline_index + 2].y);
-				merge_skylines(skyline_0l);
-				// delta
-				if (min_delta > skyline_0l.size() - _skyline.size()) {
-					min_delta = skyline_0l.size() - _skyline.size();
-					concave->rotation = Rotation::_0_;
-					concave->lb_point = lb_point_0l;
-					skyline = skyline_0l;
-					skyline_height = skyline_height_bk;
-				}
+				if (best.key.ltc_delta == numeric_limits<int>::max())  // LTC放不下
+					best_polygon_index = best.rect_index;
+				else // LTC能放下
+					best_polygon_index = _catalog.area(best.rect_index) > _catalog.area(best.ltc_index) ? best.rect_index : best.ltc_index;
 			}
 
-			if (concave->hd < space.width) { // 0&
-				// lb_point
-				point_t lb_point_0r = { skyline_0r[skyline_index].x + space.width - concave->hd, skyline_0r[skyline_index].y };
-				// update
-				skyline_0r[skyline_index].width -= concave->hd;
-				// add
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 1, {
-					skyline_0r[skyline_index].x + skyline_0r[skyline_index].width,
-					skyline_0r[skyline_index].y + concave->vld,
-					concave->hl });
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 2, {
-					skyline_0r[skyline_index + 1].x + skyline_0r[skyline_index + 1].width,
-					skyline_0r[skyline_index + 1].y - concave->vlu,
-					concave->hu });
-				skyline_0r.insert(skyline_0r.begin() + skyline_index + 3, {
-					skyline_0r[skyline_index + 2].x + skyline_0r[skyline_index + 2].width,
-					skyline_0r[skyline_index + 2].y + concave->vru,
-					concave->hr });
-				// merge
-				coord_t skyline_height_bk = max(skyline_0r[skyline_index + 1].y, skyline_0r[skyline_index + 3].y);
-				merge_skylines(skyline_0r);
-				// delta
-				if (min_delta > skyline_0r.size() - _skyline.size()) {
-					min_delta = skyline_0r.size() - _skyline.size();
-					concave->rotation = Rotation::_0_;
-					concave->lb_point = lb_point_0r;
-					skyline = skyline_0r;
-					skyline_height = skyline_height_bk;
-				}
+			switch (_catalog.shape(best_polygon_index)) {
+			case Shape::R:
+				best_rect_skyline.apply(_skyline);
+				best_skyline_height = best_rect_height;
+				best_dst_node = best.rect_placement;
+				break;
+			case Shape::L:
+			case Shape::T:
+			case Shape::C:
+				best.ltc_skyline.apply(_skyline);
+				best_skyline_height = best.ltc_height;
+				best_dst_node = best.ltc_placement;
+				break;
+			default:
+				assert(false);
+				break;
 			}
-
-			if (min_delta == numeric_limits<int>::max()) { return false; }
 			return true;
 		}
 
-		/// ϲͬһlevelskylineڵ.
-		static void merge_skylines(skyline_t &skyline) {
-			skyline.erase(
-				remove_if(skyline.begin(), skyline.end(), [](skylinenode_t &lhs) { return lhs.width <= 0; }),
-				skyline.end()
-			);
-			for (size_t i = 0; i < skyline.size() - 1; ++i) {
-				if (skyline[i].y == skyline[i + 1].y) {
-					skyline[i].width += skyline[i + 1].width;
-					skyline.erase(skyline.begin() + i + 1);
-					--i;
-				}
-			}
-		}
-
 	private:
-		// 
-		const vector<polygon_ptr> &_src;
+		// 输入
+		const vector<polygon_ptr> &_src;  // 只用于生成初始排序规则
+		const catalog_t &_catalog;        // 打分用的尺寸表
+		const vector<coord_t> _footprints; // 各多边形所需的最小skyline宽度
 		coord_t _bin_width;
+		const evaluator_t _evaluator;    // 所有最下最左的打分都经由它，只读_catalog和传入的skyline
 		coord_t _bin_height;
 
-		// 
-		vector<polygon_ptr> _dst;
+		// 输出
+		vector<placement_t> _dst;
+		DecodeTrace _trace;              // RLS最近一次解码的记录，各次解码复用，改进时才拷贝到_dst
 		coord_t _obj_area;
+		atomic<coord_t> *_incumbent_area; // 各宽度共享的最优面积，可为空
 
 		skyline_t _skyline;
-		vector<SortRule> _sort_rules; // бRLS
-		list<size_t> _polygons;		  // SortRulesequence൱ָ룬ʹlistɾΪ
-		//TabuTable _tabu_table;        // ɱ
-		discrete_distribution<> _discrete_dist;   // ɢʷֲѡ(ѡsequence_polygons)
-		uniform_int_distribution<> _uniform_dist; // ȷֲڽsequence˳
-		default_random_engine &_gen;
+		vector<SortRule> _sort_rules; // 排序规则列表，用于RLS
+		PolygonOrder _order;          // 当前解码的SortRule的sequence及其fit mask
+		PolygonPool _polygons;        // 尚未放置的多边形，按_order的位存放，放置完毕为空
+		intermediate_solu _test_solu;  // beam search扩展时试放用的中间解，各次扩展复用
+		PolygonPool _rollout_polygons; // beam search rollout中剩余的多边形，各次rollout复用
+		discrete_distribution<> _discrete_dist;   // 离散概率分布，用于挑选规则(即挑选sequence赋给_polygons)
+		uniform_int_distribution<> _uniform_dist; // 均匀分布，用于交换sequence顺序
+		default_random_engine _gen;               // 各求解器独立的随机数引擎，可在不同线程上运行
+
+		utils::ThreadPool *_pool;                 // 并行beam search和批量RLS使用的线程池，可为空
+		vector<unique_ptr<MpwBinPack>> _workers;  // 线程池各工作线程独占的求解器副本
+
+		TranspositionTable<size_t> _beam_table;       // beam search中状态键到future_height
+		VisitedFilter _visited;                       // RLS解码过的sequence，按SortRule::visit_key()记录
+		size_t _shared_rollouts;                      // beam search中沿用同代重复状态rollout结果的子代数
+		size_t _decoded_steps;                        // RLS解码执行的步数
+		size_t _noop_moves;                           // RLS中跳过的不改变解码结果的交换
+		size_t _evaluated_moves;                      // RLS中解码评估的邻域动作
+		vector<RuleMove> _batch_moves;                // 批量RLS当前一批中要解码的邻域动作
+		vector<coord_t> _batch_heights;               // 按_batch_moves，解码得到的高度
+		vector<DecodeTrace> _batch_traces;            // 按_batch_moves，解码记录，各批复用
+		vector<StepCandidate> _step_candidates;       // RLS解码中当前一步放得下的候选，各步复用
+		HeightMap _height_map;                        // 整条skyline放置时逐列的高度，各步复用
+		vector<CandidateScore> _class_scores;         // 按等价类，最近一次为该类打分的结果
+		vector<size_t> _class_stamps;                 // 按等价类，_class_scores所属的步
+		CandidateScore _single_score;                 // 只有一个成员的类的打分结果
+		size_t _score_stamp;                          // 当前一步的编号
+		unordered_map<uint64_t, uint32_t> _rect_index; // 矩形的(宽, 高)到分组编号，找打分为7或6的矩形
+		vector<uint32_t> _rect_groups;                // 按id，矩形所在的分组，其余为PolygonOrder::NoGroup；只有beam search的放置顺序按它建分组掩码
 	};
 	
 }
@@ -0,0 +1,280 @@
+//
+// @author   liyan
+// @contact  lyan_dut@outlook.com
+//
+#ifndef SMARTMPW_PLACEMENTEVALUATOR_HPP
+#define SMARTMPW_PLACEMENTEVALUATOR_HPP
+
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+#include "Data.hpp"
+#include "Skyline.hpp"
+
+namespace mbp {
+
+	using namespace std;
+
+	/// 最下最左的角上的打分：只读尺寸表和传入的skyline，结果全部写入出参，不修改任何共享状态
+	/// 同一个评估器可以同时在多个skyline上、多个线程中使用；MpwBinPack的各种解码都通过它打分
+	template<typename Coord = coord_t>
+	class PlacementEvaluator {
+	public:
+		using placement_t = Placement<Coord>;
+		using catalog_t = PolygonCatalog<Coord, coord_t>;
+		using skylinenode_t = SkyLineNode<Coord>;
+		using skyline_t = Skyline<Coord>;
+		using profile_t = OrientationProfile<Coord>;
+
+		/// Space定义
+		struct SkylineSpace {
+			coord_t x;
+			coord_t y;
+			coord_t width;
+			coord_t hl;
+			coord_t hr;
+		};
+
+
+		/// 打分时用coord_t计算，存入skyline时再收窄为Coord
+		static skylinenode_t skyline_node(coord_t x, coord_t y, coord_t width) {
+			return { static_cast<Coord>(x), static_cast<Coord>(y), static_cast<Coord>(width) };
+		}
+
+
+		/// skyline的局部副本：只复制skyline_index左右各Radius个节点，下标仍沿用整条skyline的下标
+		/// 原skyline总是合并好的，放置只改动窗口内的节点，所以合并也只会发生在窗口内
+		/// 打分时各种放置方式都在栈上的副本里试放，只有最终选中的方式才写回skyline
+		struct SkylinePatch {
+			static constexpr size_t Radius = 2;
+			static constexpr size_t Capacity = 2 * Radius + 1 + 4;  // L/T/C试放时当前节点换成5个节点，其中宽度为0的由merge删除
+
+			size_t first;       // 窗口在原skyline中的起始下标
+			size_t last;        // 窗口在原skyline中的结束下标(不含)
+			size_t base_size;   // 原skyline的节点数
+			size_t count;       // 窗口内当前的节点数
+			skylinenode_t nodes[Capacity];
+
+			SkylinePatch() : first(0), last(0), base_size(0), count(0) {}
+
+			SkylinePatch(const skyline_t &skyline, size_t skyline_index) :
+				first(skyline_index > Radius ? skyline_index - Radius : 0),
+				last(min(skyline_index + Radius + 1, skyline.size())),
+				base_size(skyline.size()), count(last - first) {
+				for (size_t i = first; i < last; ++i) { nodes[i - first] = skyline[i]; }
+			}
+
+			/// 写回后整条skyline的节点数
+			size_t size() const { return base_size - (last - first) + count; }
+
+			skylinenode_t &operator[](size_t index) { return nodes[index - first]; }
+			const skylinenode_t &operator[](size_t index) const { return nodes[index - first]; }
+
+			void insert(size_t index, const skylinenode_t &node) {
+				assert(count < Capacity);
+				copy_backward(nodes + (index - first), nodes + count, nodes + count + 1);
+				nodes[index - first] = node;
+				++count;
+			}
+
+			/// 把第index个节点换成new_nodes中的n个节点
+			void replace(size_t index, const skylinenode_t *new_nodes, size_t n) {
+				assert(count + n - 1 <= Capacity);
+				size_t i = index - first;
+				if (n > 1) { copy_backward(nodes + i + 1, nodes + count, nodes + count + n - 1); }
+				else { copy(nodes + i + 1, nodes + count, nodes + i + n); }
+				copy(new_nodes, new_nodes + n, nodes + i);
+				count = count + n - 1;
+			}
+
+			/// 删除宽度为0的节点，合并同一level的相邻节点，只处理窗口内的节点
+			void merge() {
+				count = remove_if(nodes, nodes + count, [](const skylinenode_t &lhs) { return lhs.width <= 0; }) - nodes;
+				size_t n = 0;
+				for (size_t i = 0; i < count; ++i) {
+					if (n > 0 && nodes[n - 1].y == nodes[i].y) { nodes[n - 1].width += nodes[i].width; }
+					else { nodes[n++] = nodes[i]; }
+				}
+				count = n;
+			}
+
+			/// 把窗口写回skyline，skyline须与构造时的一致
+			void apply(skyline_t &skyline) const {
+				skyline.replace(first, last, nodes, count);
+			}
+		};
+
+		/// 候选在最下最左的角上的打分结果，与块的id无关，同一等价类的块都相同
+		struct CandidateScore {
+			bool rect_fit[2];           // R两种旋转各自能否放下
+			coord_t rect_x[2];
+			int rect_score[2];
+			bool ltc_fit;               // L/T/C能否放下，以下为其最好的放置方式
+			SkylinePatch ltc_skyline;
+			placement_t ltc_placement;  // id为打分时的块，使用时换成实际的块
+			coord_t ltc_height, ltc_waste;
+		};
+
+		PlacementEvaluator(const catalog_t &catalog, coord_t bin_width) : _catalog(catalog), _bin_width(bin_width) {}
+
+		/// 给块p在skyline的第skyline_index个节点上打分，写入score
+		void evaluate(const skyline_t &skyline, size_t skyline_index, size_t p, CandidateScore &score) const {
+			if (_catalog.shape(p) == Shape::R) {
+				auto rect = _catalog.rect(p);
+				for (int rotate = 0; rotate <= 1; ++rotate) {            //矩形可以旋转1次
+					coord_t w = rect->width, h = rect->height;
+					if (rotate) { swap(w, h); }
+					score.rect_fit[rotate] = score_rect(skyline, skyline_index, w, h, score.rect_x[rotate], score.rect_score[rotate]);
+				}
+				return;
+			}
+			score.ltc_placement = placement_t(p); //旋转在打分策略里面
+			score.ltc_fit = score_profiles(skyline, skyline_index, p, score.ltc_skyline, score.ltc_placement, score.ltc_height, score.ltc_waste);
+		}
+
+		/// 矩形按placement放在第skyline_index个节点上(靠左或靠右)后的窗口，返回放下后矩形的顶边高度
+		coord_t place_rect(const skyline_t &skyline, size_t skyline_index, const placement_t &placement, SkylinePatch &patch) const {
+			auto rect = _catalog.rect(placement.id);
+			coord_t w = rect->width, h = rect->height;
+			if (placement.rotation == Rotation::_90_) { swap(w, h); }
+			patch = SkylinePatch(skyline, skyline_index);
+			skylinenode_t new_skyline_node = skyline_node(placement.x, placement.y + h, w);
+			if (placement.x == patch[skyline_index].x) { // 靠左
+				patch.insert(skyline_index, new_skyline_node);
+				patch[skyline_index + 1].x += w;
+				patch[skyline_index + 1].width -= w;
+			}
+			else { // 靠右
+				patch.insert(skyline_index + 1, new_skyline_node);
+				patch[skyline_index].width -= w;
+			}
+			patch.merge();
+			return new_skyline_node.y;
+		}
+
+		static SkylineSpace skyline_nodo_to_space(const skyline_t &skyline, size_t skyline_index) {          //返回一个space，这个space的x，y是对应skyline的x和y，宽度是space的宽度
+			coord_t hl, hr;                                                 //hl和hr是左右墙的相对高度
+			if (skyline.size() == 1) {
+				hl = hr = INF - skyline[skyline_index].y;
+			}
+			else if (skyline_index == 0) {
+				hl = INF - skyline[skyline_index].y;
+				hr = skyline[skyline_index + 1].y - skyline[skyline_index].y;
+			}
+			else if (skyline_index == skyline.size() - 1) {
+				hl = skyline[skyline_index - 1].y - skyline[skyline_index].y;
+				hr = INF - skyline[skyline_index].y;
+			}
+			else {
+				hl = skyline[skyline_index - 1].y - skyline[skyline_index].y;
+				hr = skyline[skyline_index + 1].y - skyline[skyline_index].y;
+			}
+			return { skyline[skyline_index].x, skyline[skyline_index].y, skyline[skyline_index].width, hl, hr };
+		}
+
+		/// R打分策略
+		bool score_rect(const skyline_t &skyline, size_t skyline_index, coord_t width, coord_t height, coord_t &x, int &score) const {
+			if (width > skyline[skyline_index].width) { return false; }
+
+			SkylineSpace space = skyline_nodo_to_space(skyline, skyline_index);                 //确定这个skyline对应的space
+			if (space.hl >= space.hr) {                                                //左墙更高
+				if (width == space.width && height == space.hl) { score = 7; }
+				else if (width == space.width && height == space.hr) { score = 6; }
+				else if (width == space.width && height > space.hl) { score = 5; }
+				else if (width < space.width && height == space.hl) { score = 4; }
+				else if (width == space.width && height < space.hl && height > space.hr) { score = 3; }
+				else if (width < space.width && height == space.hr) { score = 2; } // 靠右
+				else if (width == space.width && height < space.hr) { score = 1; }
+				else if (width < space.width && height != space.hl) { score = 0; }
+				else { return false; }
+
+				if (score == 2) { x = skyline[skyline_index].x + skyline[skyline_index].width - width; }  //靠右放置
+				else { x = skyline[skyline_index].x; }
+			}
+			else { // hl < hr，右墙更高
+				if (width == space.width && height == space.hr) { score = 7; }
+				else if (width == space.width && height == space.hl) { score = 6; }
+				else if (width == space.width && height > space.hr) { score = 5; }
+				else if (width < space.width && height == space.hr) { score = 4; } // 靠右
+				else if (width == space.width && height < space.hr && height > space.hl) { score = 3; }
+				else if (width < space.width && height == space.hl) { score = 2; }
+				else if (width == space.width && height < space.hl) { score = 1; }
+				else if (width < space.width && height != space.hr) { score = 0; } // 靠右
+				else { return false; }
+
+				if (score == 4 || score == 0) { x = skyline[skyline_index].x + skyline[skyline_index].width - width; } //靠右放置
+				else { x = skyline[skyline_index].x; }
+			}
+			if (x + width > _bin_width) { return false; }
+
+			return true;
+		}
+
+		/// L/T/C打分策略：按尺寸表中的顺序匹配p的各放置方式，所有形状和旋转共用
+		/// allow_gap的放置方式先比较浪费再比较skyline节点数的变化量，其余只比较变化量，min_waste只对L有意义
+		bool score_profiles(const skyline_t &skyline, size_t skyline_index, size_t p, SkylinePatch &best_patch, placement_t &placement, coord_t &skyline_height, coord_t &min_waste) const {
+			SkylineSpace space = skyline_nodo_to_space(skyline, skyline_index);
+			int min_delta = numeric_limits<int>::max();
+			min_waste = numeric_limits<coord_t>::max();
+			const SkylinePatch window(skyline, skyline_index);   // 各放置方式都从这个窗口出发试放
+
+			for (const profile_t *profile = _catalog.profile_begin(p); profile != _catalog.profile_end(p); ++profile) {
+				coord_t slack = space.width - profile->mid;
+				if (slack < profile->min_slack || slack > profile->max_slack) { continue; }
+				// 搭上去的部分不超出相邻的skyline
+				if (profile->hang_l > 0 && (skyline_index < 1 || profile->hang_l > skyline[skyline_index - 1].width)) { continue; }
+				if (profile->hang_r > 0 && (skyline_index + 1 >= skyline.size() || profile->hang_r > skyline[skyline_index + 1].width)) { continue; }
+				// 中段底边抬高到两侧都能搭上，抬高后中段下方和两侧下方的空隙计为浪费
+				coord_t gap_l = profile->hang_l > 0 ? space.hl - profile->lift_l : 0;
+				coord_t gap_r = profile->hang_r > 0 ? space.hr - profile->lift_r : 0;
+				if (!profile->allow_gap && (gap_l != 0 || gap_r != 0)) { continue; }
+				coord_t base = max({ coord_t(0), gap_l, gap_r });
+				coord_t waste = base * profile->mid + (base - gap_l) * profile->hang_l + (base - gap_r) * profile->hang_r;
+
+				coord_t x = space.x + (profile->align_right ? slack : 0) - profile->hang_l;   // 形状的左端
+				coord_t y = space.y + base;                                                    // 中段的底边
+				SkylinePatch patch = window;
+				if (profile->hang_l > 0) { patch[skyline_index - 1].width -= profile->hang_l; }
+				if (profile->hang_r > 0) {
+					patch[skyline_index + 1].x += profile->hang_r;
+					patch[skyline_index + 1].width -= profile->hang_r;
+				}
+				// 当前节点换成中段左侧剩余、形状的顶边和中段右侧剩余，不用的顶边和剩余宽度为0，由merge删除
+				coord_t left_rest = profile->align_right ? slack : 0;
+				skylinenode_t nodes[5];
+				nodes[0] = skyline_node(space.x, space.y, left_rest);
+				coord_t node_x = x;
+				for (size_t k = 0; k < 3; ++k) {
+					nodes[k + 1] = skyline_node(node_x, y + profile->tops[k].height, profile->tops[k].width);
+					node_x += profile->tops[k].width;
+				}
+				nodes[4] = skyline_node(space.x + profile->mid, space.y, slack - left_rest);
+				patch.replace(skyline_index, nodes, 5);
+				patch.merge();
+
+				// delta是增加的skyline节点数，沿用原实现按无符号数比较：合并掉节点时回绕成很大的数，这样的放置不会被选中
+				size_t delta = patch.size() - skyline.size();
+				if (profile->allow_gap ?
+					(min_waste > waste || (min_waste == waste && size_t(min_delta) > delta)) :   //浪费越小越好
+					size_t(min_delta) > delta) {                                                  //delta越小越好
+					min_waste = waste;
+					min_delta = int(delta);
+					placement.rotation = profile->rotation;
+					placement.set_lb_point(point_t(x + profile->lb_dx, y + profile->lb_dy));
+					best_patch = patch;
+					skyline_height = y + profile->top;    //放下后这个形状的最高点，不一定是整条skyline的最高点
+				}
+			}
+
+			return min_delta != numeric_limits<int>::max();
+		}
+
+	private:
+		const catalog_t &_catalog;
+		coord_t _bin_width;
+	};
+
+}
+
+#endif // SMARTMPW_PLACEMENTEVALUATOR_HPP
@@ -0,0 +1,216 @@
+//
+// @author   liyan
+// @contact  lyan_dut@outlook.com
+//
+#ifndef SMARTMPW_POLYGONPOOL_HPP
+#define SMARTMPW_POLYGONPOOL_HPP
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cassert>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+#include "Data.hpp"
+#include "TranspositionTable.hpp"
+
+/// 最低位1的下标，word不为0
+inline int lowest_bit(uint64_t word) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(word);
+#endif // _MSC_VER
+}
+
+/// 放置顺序：第pos位对应sequence[pos]，并按footprint预先算好fit mask
+/// footprint是多边形任一放置方式所需的最小skyline宽度，宽度为w的skyline只需考虑footprint<=w的多边形
+/// 载入时可另给出多边形的分组，为每组维护一个位掩码，用于按组找位置最靠前的剩余多边形
+class PolygonOrder {
+public:
+	static constexpr uint32_t NoGroup = static_cast<uint32_t>(-1);
+
+	PolygonOrder() : _word_num(0), _group_num(0) {}
+
+	/// 各多边形的footprint，与MpwBinPack中各打分策略的宽度条件对应，尺寸表可以是紧凑坐标的
+	template<typename Catalog>
+	static std::vector<coord_t> footprints(const Catalog &catalog) {
+		std::vector<coord_t> res; res.reserve(catalog.size());
+		for (size_t id = 0; id < catalog.size(); ++id) {
+			if (catalog.shape(id) == Shape::R) {
+				auto rect = catalog.rect(id);
+				res.push_back(std::min(rect->width, rect->height));
+				continue;
+			}
+			coord_t footprint = std::numeric_limits<coord_t>::max();
+			for (auto profile = catalog.profile_begin(id); profile != catalog.profile_end(id); ++profile) {
+				footprint = std::min<coord_t>(footprint, profile->mid);
+			}
+			res.push_back(footprint);
+		}
+		return res;
+	}
+
+	/// 第r行是footprint不超过_thresholds[r-1]的位，第0行为空；各行只与位上的多边形有关，重新载入时不再申请内存
+	/// groups不为空时groups[id]为多边形id所在的组(编号从0连续)，不属于任何组的为NoGroup；为空时不建分组掩码
+	void assign(const std::vector<size_t> &sequence, const std::vector<coord_t> &footprints, const std::vector<uint32_t> *groups = nullptr) {
+		_sequence = sequence;
+		_position.resize(footprints.size());
+		_row.resize(footprints.size());
+		_word_num = (_sequence.size() + 63) / 64;
+
+		_thresholds.clear();
+		for (size_t id : _sequence) { _thresholds.push_back(footprints[id]); }
+		std::sort(_thresholds.begin(), _thresholds.end());
+		_thresholds.erase(std::unique(_thresholds.begin(), _thresholds.end()), _thresholds.end());
+		for (size_t id : _sequence) {
+			_row[id] = std::lower_bound(_thresholds.begin(), _thresholds.end(), footprints[id]) - _thresholds.begin() + 1;
+		}
+		_masks.resize((_thresholds.size() + 1) * _word_num);
+
+		_groups.clear();
+		_group_num = 0;
+		if (groups) {
+			_groups = *groups;
+			for (uint32_t g : _groups) { if (g != NoGroup) { _group_num = std::max<size_t>(_group_num, g + 1); } }
+		}
+		_group_masks.resize(_group_num * _word_num);
+		rebuild();
+	}
+
+	/// 交换a、b两处的多边形：只有两者行号之间的各行中这两位会改变
+	void swap(size_t a, size_t b) {
+		size_t row_a = _row[_sequence[a]], row_b = _row[_sequence[b]];
+		std::swap(_sequence[a], _sequence[b]);
+		_position[_sequence[a]] = a;
+		_position[_sequence[b]] = b;
+		for (size_t r = std::min(row_a, row_b); r < std::max(row_a, row_b); ++r) {
+			uint64_t *mask = _masks.data() + r * _word_num;
+			mask[a / 64] ^= uint64_t(1) << (a % 64);
+			mask[b / 64] ^= uint64_t(1) << (b % 64);
+		}
+		if (!_groups.empty() && _groups[_sequence[a]] != _groups[_sequence[b]]) {
+			flip_group_bit(_groups[_sequence[a]], a); flip_group_bit(_groups[_sequence[a]], b);
+			flip_group_bit(_groups[_sequence[b]], a); flip_group_bit(_groups[_sequence[b]], b);
+		}
+	}
+
+	/// 轮转使第pos处的多边形成为首个，各位都会移动，重建位置和fit mask
+	void rotate(size_t pos) {
+		std::rotate(_sequence.begin(), _sequence.begin() + pos, _sequence.end());
+		rebuild();
+	}
+
+	size_t size() const { return _sequence.size(); }
+	size_t word_num() const { return _word_num; }
+	size_t at(size_t pos) const { return _sequence[pos]; }
+	size_t position(size_t id) const { return _position[id]; }
+
+	/// 能放进宽度为width的skyline的位
+	const uint64_t *fit_mask(coord_t width) const {
+		size_t row = std::upper_bound(_thresholds.begin(), _thresholds.end(), width) - _thresholds.begin();
+		return _masks.data() + row * _word_num;
+	}
+
+	/// 第group组多边形所在的位，须在assign时给出分组
+	const uint64_t *group_mask(uint32_t group) const {
+		assert(group < _group_num);
+		return _group_masks.data() + group * _word_num;
+	}
+
+private:
+	/// 按_sequence和_row重建_position和_masks：每位先只记入所在行，再逐行并入上一行
+	void rebuild() {
+		std::fill(_masks.begin(), _masks.end(), 0);
+		for (size_t pos = 0; pos < _sequence.size(); ++pos) {
+			_position[_sequence[pos]] = pos;
+			_masks[_row[_sequence[pos]] * _word_num + pos / 64] |= uint64_t(1) << (pos % 64);
+		}
+		for (size_t i = 2 * _word_num; i < _masks.size(); ++i) { _masks[i] |= _masks[i - _word_num]; }
+
+		std::fill(_group_masks.begin(), _group_masks.end(), 0);
+		if (_groups.empty()) { return; }
+		for (size_t pos = 0; pos < _sequence.size(); ++pos) {
+			uint32_t g = _groups[_sequence[pos]];
+			if (g != NoGroup) { flip_group_bit(g, pos); }
+		}
+	}
+
+	void flip_group_bit(uint32_t group, size_t pos) {
+		if (group == NoGroup) { return; }
+		_group_masks[group * _word_num + pos / 64] ^= uint64_t(1) << (pos % 64);
+	}
+
+private:
+	std::vector<size_t> _sequence;
+	std::vector<size_t> _position;   // 多边形id在_sequence中的下标
+	std::vector<size_t> _row;        // 多边形id的footprint首次出现的行
+	std::vector<coord_t> _thresholds; // 递增的不同footprint
+	std::vector<uint64_t> _masks;     // (_thresholds.size() + 1) * _word_num
+	std::vector<uint32_t> _groups;    // 多边形id所在的组，未分组时为空
+	std::vector<uint64_t> _group_masks; // _group_num * _word_num
+	size_t _word_num;
+	size_t _group_num;
+};
+
+/// 剩余多边形集合，第pos位表示order.at(pos)尚未放置，按位遍历即按放置顺序遍历
+/// 同时维护剩余多边形id的Zobrist哈希，放置时增量更新
+class PolygonPool {
+public:
+	static constexpr size_t npos = static_cast<size_t>(-1);
+
+	PolygonPool() : _order(nullptr), _count(0), _hash(0) {}
+
+	/// 放入order中的全部多边形
+	void reset(const PolygonOrder &order) {
+		_order = &order;
+		_count = order.size();
+		_bits.assign(order.word_num(), ~uint64_t(0));
+		if (_count % 64) { _bits.back() = (uint64_t(1) << (_count % 64)) - 1; }
+		_hash = 0;
+		for (size_t pos = 0; pos < _count; ++pos) { _hash ^= zobrist_mix(order.at(pos)); }
+	}
+
+	const PolygonOrder &order() const { return *_order; }
+	bool empty() const { return _count == 0; }
+	size_t size() const { return _count; }
+	uint64_t hash() const { return _hash; }
+
+	bool contains(size_t id) const {
+		size_t pos = _order->position(id);
+		return _bits[pos / 64] >> (pos % 64) & 1;
+	}
+
+	void erase(size_t id) {
+		size_t pos = _order->position(id);
+		assert(_bits[pos / 64] >> (pos % 64) & 1);
+		_bits[pos / 64] &= ~(uint64_t(1) << (pos % 64));
+		--_count;
+		_hash ^= zobrist_mix(id);
+	}
+
+	/// 不小于pos的第一个剩余位置，mask不为空时只考虑mask中的位，没有则返回npos
+	size_t find_next(size_t pos, const uint64_t *mask = nullptr) const {
+		size_t w = pos / 64;
+		if (w >= _bits.size()) { return npos; }
+		uint64_t word = _bits[w] & (mask ? mask[w] : ~uint64_t(0)) & (~uint64_t(0) << (pos % 64));
+		while (!word) {
+			if (++w == _bits.size()) { return npos; }
+			word = _bits[w] & (mask ? mask[w] : ~uint64_t(0));
+		}
+		return w * 64 + lowest_bit(word);
+	}
+
+private:
+	const PolygonOrder *_order;
+	std::vector<uint64_t> _bits;
+	size_t _count;
+	uint64_t _hash;
+};
+
+#endif // SMARTMPW_POLYGONPOOL_HPP
@@ -0,0 +1,150 @@
+//
+// @author   liyan
+// @contact  lyan_dut@outlook.com
+//
+#ifndef SMARTMPW_PROFILEFIT_HPP
+#define SMARTMPW_PROFILEFIT_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#endif
+
+#include "Config.hpp"
+#include "Skyline.hpp"
+
+/// 按编译目标选择的int32向量运算，AVX2一次8个、SSE4.1一次4个，都不支持时退化为逐个计算
+namespace fit_simd {
+
+	static_assert(sizeof(coord_t) == sizeof(int32_t), "fit kernel works on 32-bit coordinates");
+
+#if defined(__AVX2__)
+	using vec_t = __m256i;
+	constexpr size_t Lanes = 8;
+	inline vec_t load(const coord_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+	inline void store(coord_t *p, vec_t v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+	inline vec_t splat(coord_t v) { return _mm256_set1_epi32(v); }
+	inline vec_t max(vec_t a, vec_t b) { return _mm256_max_epi32(a, b); }
+	inline vec_t add(vec_t a, vec_t b) { return _mm256_add_epi32(a, b); }
+	inline vec_t sub(vec_t a, vec_t b) { return _mm256_sub_epi32(a, b); }
+	inline vec_t mul(vec_t a, vec_t b) { return _mm256_mullo_epi32(a, b); }
+#elif defined(__SSE4_1__) || defined(__AVX__)
+	using vec_t = __m128i;
+	constexpr size_t Lanes = 4;
+	inline vec_t load(const coord_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+	inline void store(coord_t *p, vec_t v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+	inline vec_t splat(coord_t v) { return _mm_set1_epi32(v); }
+	inline vec_t max(vec_t a, vec_t b) { return _mm_max_epi32(a, b); }
+	inline vec_t add(vec_t a, vec_t b) { return _mm_add_epi32(a, b); }
+	inline vec_t sub(vec_t a, vec_t b) { return _mm_sub_epi32(a, b); }
+	inline vec_t mul(vec_t a, vec_t b) { return _mm_mullo_epi32(a, b); }
+#else
+	using vec_t = coord_t;
+	constexpr size_t Lanes = 1;
+	inline vec_t load(const coord_t *p) { return *p; }
+	inline void store(coord_t *p, vec_t v) { *p = v; }
+	inline vec_t splat(coord_t v) { return v; }
+	inline vec_t max(vec_t a, vec_t b) { return std::max(a, b); }
+	inline vec_t add(vec_t a, vec_t b) { return a + b; }
+	inline vec_t sub(vec_t a, vec_t b) { return a - b; }
+	inline vec_t mul(vec_t a, vec_t b) { return a * b; }
+#endif
+
+}
+
+/// 形状底边的一段：相对于形状左端的偏移、宽度，以及底边高出中段底边的高度
+struct BottomPart {
+	coord_t dx, width, lift;
+};
+
+/// 把skyline展开成逐列的高度，对形状的底边轮廓一次算出所有左端位置上的放置高度和下方空隙
+/// 区间最大值用稀疏表：第k层存放从每列起2^k列的最大值，任意区间由两个重叠的2^k区间取max得到
+/// 各层和前缀和都多留Lanes列，整组向量读写不越界，多出的结果不使用
+class HeightMap {
+public:
+	HeightMap() : _width(0), _stride(0) {}
+
+	template<typename T, size_t N>
+	void assign(const Skyline<T, N> &skyline, coord_t width) {
+		_width = width;
+		_stride = static_cast<size_t>(width) + fit_simd::Lanes;
+		size_t level_num = 1;
+		while ((coord_t(1) << level_num) <= width) { ++level_num; }
+		_levels.resize(level_num * _stride);
+		_prefix.resize(_stride);
+
+		coord_t *height = _levels.data();
+		for (size_t i = 0; i < skyline.size(); ++i) {
+			auto node = skyline[i];
+			std::fill(height + node.x, height + node.x + node.width, static_cast<coord_t>(node.y));
+		}
+		_prefix[0] = 0;
+		for (coord_t x = 0; x < width; ++x) { _prefix[x + 1] = _prefix[x] + height[x]; }
+
+		for (size_t k = 1; k < level_num; ++k) {
+			const coord_t *lower = _levels.data() + (k - 1) * _stride;
+			coord_t *upper = _levels.data() + k * _stride;
+			size_t half = size_t(1) << (k - 1), count = static_cast<size_t>(width) - 2 * half + 1;
+			for (size_t x = 0; x < count; x += fit_simd::Lanes) {
+				fit_simd::store(upper + x, fit_simd::max(fit_simd::load(lower + x), fit_simd::load(lower + x + half)));
+			}
+		}
+	}
+
+	/// 底边由parts[0, part_num)组成、总宽为width的形状，对每个左端位置x < count计算base(x)和gap(x)，返回count
+	/// base为中段底边的最低高度：每段底边都不低于其下方skyline的最高点；gap为各段底边与skyline之间的空隙面积
+	/// 高度非负且中段的lift为0，base从0开始取max
+	size_t fit(const BottomPart *parts, size_t part_num, coord_t width) {
+		if (width > _width) { return 0; }
+		size_t count = static_cast<size_t>(_width - width) + 1;
+		_base.resize(count + fit_simd::Lanes);
+		_gap.resize(count + fit_simd::Lanes);
+
+		const coord_t *windows[3][2];   // 每段两个重叠窗口所在层的起始列
+		assert(part_num <= 3);
+		for (size_t j = 0; j < part_num; ++j) {
+			assert(parts[j].width > 0);
+			size_t k = 0;
+			while ((coord_t(2) << k) <= parts[j].width) { ++k; }
+			const coord_t *level = _levels.data() + k * _stride;
+			windows[j][0] = level + parts[j].dx;
+			windows[j][1] = level + parts[j].dx + parts[j].width - (coord_t(1) << k);
+		}
+
+		for (size_t x = 0; x < count; x += fit_simd::Lanes) {
+			fit_simd::vec_t base = fit_simd::splat(0);
+			for (size_t j = 0; j < part_num; ++j) {
+				fit_simd::vec_t top = fit_simd::max(fit_simd::load(windows[j][0] + x), fit_simd::load(windows[j][1] + x));
+				base = fit_simd::max(base, fit_simd::sub(top, fit_simd::splat(parts[j].lift)));
+			}
+			fit_simd::vec_t gap = fit_simd::splat(0);
+			for (size_t j = 0; j < part_num; ++j) {
+				const coord_t *prefix = _prefix.data() + x + parts[j].dx;
+				fit_simd::vec_t bottom = fit_simd::add(base, fit_simd::splat(parts[j].lift));
+				fit_simd::vec_t covered = fit_simd::sub(fit_simd::load(prefix + parts[j].width), fit_simd::load(prefix));
+				gap = fit_simd::add(gap, fit_simd::sub(fit_simd::mul(bottom, fit_simd::splat(parts[j].width)), covered));
+			}
+			fit_simd::store(_base.data() + x, base);
+			fit_simd::store(_gap.data() + x, gap);
+		}
+		return count;
+	}
+
+	const coord_t *base() const { return _base.data(); }
+	const coord_t *gap() const { return _gap.data(); }
+
+private:
+	coord_t _width;
+	size_t _stride;
+	std::vector<coord_t> _levels;  // 稀疏表，第0层是逐列的高度
+	std::vector<coord_t> _prefix;  // 高度的前缀和，_prefix[x]为[0, x)列的高度之和
+	std::vector<coord_t> _base;
+	std::vector<coord_t> _gap;
+};
+
+#endif // SMARTMPW_PROFILEFIT_HPP
@@ -0,0 +1,322 @@
+//
+// @author   liyan
+// @contact  lyan_dut@outlook.com
+//
+#ifndef SMARTMPW_SKYLINE_HPP
+#define SMARTMPW_SKYLINE_HPP
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+#include "Data.hpp"
+#include "TranspositionTable.hpp"
+
+/// skyline容器，x/y/width按SoA存放在同一块连续内存中
+/// 节点数不超过N时使用内嵌存储，beam search中拷贝中间解时不需要申请内存
+/// 另外维护按(y, x)排列的小根堆、最高高度和各节点Zobrist键的异或，bottom()、height()和hash()不必扫描全部节点
+/// 节点只能通过insert、replace、merge、raise和split修改，operator[]只读，这样堆和哈希才能随修改一起更新
+/// push_mark()之后的insert、replace、merge、raise和split都记入撤销日志，rollback()按日志逆序恢复到标记时的节点，
+/// 代价只与标记后改动的节点数有关；标记期间不能通过operator[]直接改写节点，这种修改不会被记录
+template<typename T, size_t N = 32>
+class Skyline {
+public:
+	using node_t = SkyLineNode<T>;
+
+	/// 节点数不超过该值时bottom()线性扫描
+	/// 在n个节点上反复执行bottom()、raise()、merge()的测试中(-O2，每步的耗时)，扫描在n=8/32/64/128时为40/114/197/371ns，
+	/// 堆为128/228/306/527ns，到n=256时堆才更快；插入和拆分会往堆里压入更多记录，实际解码中分界点只会更高
+	/// 留出余量取64；算例的skyline很少超过这个节点数，input_4/6/9上取24、64、128的beam search总耗时相差在测量波动以内
+	static constexpr size_t ScanLimit = 64;
+
+	Skyline() : _size(0), _capacity(N), _pq_size(0), _pq_stale(false), _max_y(std::numeric_limits<T>::lowest()), _hash(0) { bind(_local, _local_pq); }
+
+	Skyline(const Skyline &other) : _size(0), _capacity(N), _pq_size(0), _pq_stale(false), _max_y(std::numeric_limits<T>::lowest()), _hash(0) {
+		bind(_local, _local_pq);
+		*this = other;
+	}
+
+	/// 只拷贝节点，堆等到下次bottom()时按当前节点重建，beam search中很多拷贝出的中间解不会再找最低节点
+	/// 撤销日志不拷贝，原有的标记全部丢弃
+	Skyline &operator=(const Skyline &other) {
+		if (this == &other) { return *this; }
+		reserve(other._size);
+		_size = other._size;
+		std::copy(other._x, other._x + _size, _x);
+		std::copy(other._y, other._y + _size, _y);
+		std::copy(other._width, other._width + _size, _width);
+		_pq_stale = true;
+		_max_y = other._max_y;
+		_hash = other._hash;
+		drop_marks();
+		return *this;
+	}
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	void clear() { _size = 0; _pq_size = 0; _pq_stale = false; _max_y = std::numeric_limits<T>::lowest(); _hash = 0; drop_marks(); }
+
+	node_t operator[](size_t index) const { return { _x[index], _y[index], _width[index] }; }
+
+	void push_back(const node_t &node) { insert(_size, node); }
+
+	void insert(size_t index, const node_t &node) {
+		assert(index <= _size);
+		record(index, index, 1);
+		reserve(_size + 1);
+		std::copy_backward(_x + index, _x + _size, _x + _size + 1);
+		std::copy_backward(_y + index, _y + _size, _y + _size + 1);
+		std::copy_backward(_width + index, _width + _size, _width + _size + 1);
+		_x[index] = node.x; _y[index] = node.y; _width[index] = node.width;
+		++_size;
+		_hash ^= node_key(node.x, node.y, node.width);
+		push_pq(node.y, node.x);
+	}
+
+	/// 用nodes[0, count)替换[first, last)中的节点
+	void replace(size_t first, size_t last, const node_t *nodes, size_t count) {
+		assert(first <= last && last <= _size);
+		size_t new_size = _size - (last - first) + count;
+		record(first, last, count);
+		unhash(first, last);
+		reserve(new_size);
+		move_tail(last, first + count);
+		for (size_t i = 0; i < count; ++i) {
+			_x[first + i] = nodes[i].x; _y[first + i] = nodes[i].y; _width[first + i] = nodes[i].width;
+		}
+		_size = new_size;
+		for (size_t i = 0; i < count; ++i) {
+			_hash ^= node_key(nodes[i].x, nodes[i].y, nodes[i].width);
+			push_pq(nodes[i].y, nodes[i].x);
+		}
+	}
+
+	/// 在index附近原地合并：删除宽度为0的节点，合并同一level的相邻节点
+	/// 除[index - 2, index + 2]以外的节点须已合并完毕，放置和填坑都只改动这个范围
+	void merge(size_t index) {
+		size_t first = index > 2 ? index - 2 : 0;
+		size_t last = std::min(index + 3, _size);
+		record(first, last, 0);
+		unhash(first, last);
+		size_t n = first;
+		for (size_t i = first; i < last; ++i) {
+			if (_width[i] <= 0) { continue; }
+			if (n > first && _y[n - 1] == _y[i]) { _width[n - 1] += _width[i]; continue; }
+			_x[n] = _x[i]; _y[n] = _y[i]; _width[n] = _width[i];
+			++n;
+		}
+		move_tail(last, n);
+		_size -= last - n;
+		if (!_marks.empty()) { _log.back().count = n - first; }
+		for (size_t i = first; i < n; ++i) {
+			_hash ^= node_key(_x[i], _y[i], _width[i]);
+			push_pq(_y[i], _x[i]);
+		}
+	}
+
+	/// 把第index个节点升高到y，之后须调用merge(index)
+	void raise(size_t index, T y) {
+		assert(y >= _y[index]);
+		record(index, index + 1, 1);
+		_hash ^= node_key(_x[index], _y[index], _width[index]) ^ node_key(_x[index], y, _width[index]);
+		_y[index] = y;
+	}
+
+	/// 把node放在第index个节点上，node与该节点左对齐或右对齐，该节点换成node和剩余的部分，之后须调用merge(index)
+	/// 剩余部分宽度为0时留给merge删除
+	void split(size_t index, const node_t &node) {
+		node_t rest = (*this)[index];
+		rest.width -= node.width;
+		node_t nodes[2] = { node, rest };
+		if (node.x == _x[index]) { nodes[1].x += node.width; }
+		else { std::swap(nodes[0], nodes[1]); }
+		replace(index, index + 1, nodes, 2);
+	}
+
+	/// 标记当前状态，标记可以嵌套
+	void push_mark() { _marks.push_back({ _log.size(), _saved.size(), _max_y, _hash }); }
+
+	/// 撤销最近一次标记之后的全部修改，并弹出该标记
+	/// 恢复出的节点重新入堆，被撤销的节点在堆中的记录和合并掉的节点一样由bottom()弹出
+	void rollback() {
+		assert(!_marks.empty());
+		Mark mark = _marks.back();
+		_marks.pop_back();
+		while (_log.size() > mark.log_size) {
+			UndoEntry entry = _log.back();
+			_log.pop_back();
+			size_t new_size = _size - entry.count + entry.removed;
+			reserve(new_size);
+			move_tail(entry.first + entry.count, entry.first + entry.removed);
+			_size = new_size;
+			for (size_t i = 0; i < entry.removed; ++i) {
+				const node_t &node = _saved[entry.saved + i];
+				_x[entry.first + i] = node.x; _y[entry.first + i] = node.y; _width[entry.first + i] = node.width;
+				push_pq(node.y, node.x);
+			}
+		}
+		_saved.resize(mark.saved_size);
+		_max_y = mark.max_y;
+		_hash = mark.hash;
+	}
+
+	/// 最下最左的节点下标
+	/// 节点不多时直接扫描连续存放的y，比维护堆更快，此时堆停止更新
+	/// 节点被修改或合并掉后，堆中的旧记录不会立即删除；取堆顶时按x找回节点，y对不上或节点已不存在就弹出
+	size_t bottom() {
+		if (_size <= ScanLimit) {
+			_pq_stale = true;
+			return std::min_element(_y, _y + _size) - _y;
+		}
+		if (_pq_stale) { rebuild_pq(); }
+		for (;;) {
+			assert(_pq_size > 0);
+			size_t index = std::lower_bound(_x, _x + _size, _pq[0].x) - _x;
+			if (index < _size && _x[index] == _pq[0].x && _y[index] == _pq[0].y) {
+				assert(index == size_t(std::min_element(_y, _y + _size) - _y));
+				return index;
+			}
+			std::pop_heap(_pq, _pq + _pq_size, PqGreater());
+			--_pq_size;
+		}
+	}
+
+	/// 最高节点的高度，节点的y只增不减，入堆时顺便记录最大值即可
+	T height() const {
+		assert(_max_y == *std::max_element(_y, _y + _size));
+		return _max_y;
+	}
+
+	/// 各节点Zobrist键的异或，随每次修改增量更新，rollback时从标记中恢复
+	uint64_t hash() const {
+		assert(_hash == full_hash());
+		return _hash;
+	}
+
+private:
+	/// 堆中的一条记录，入堆时节点的y和x
+	struct PqEntry {
+		T y, x;
+	};
+
+	/// 撤销日志中的一条：[first, first + count)中的节点替换了_saved中从saved起的removed个节点
+	struct UndoEntry {
+		size_t first, count;
+		size_t saved, removed;
+	};
+
+	/// 标记时日志的长度、最高高度和哈希
+	struct Mark {
+		size_t log_size, saved_size;
+		T max_y;
+		uint64_t hash;
+	};
+
+	struct PqGreater {
+		bool operator()(const PqEntry &lhs, const PqEntry &rhs) const {
+			return lhs.y != rhs.y ? lhs.y > rhs.y : lhs.x > rhs.x;
+		}
+	};
+
+	void bind(T *buf, PqEntry *pq) {
+		_x = buf;
+		_y = buf + _capacity;
+		_width = buf + 2 * _capacity;
+		_pq = pq;
+	}
+
+	void reserve(size_t size) {
+		if (size <= _capacity) { return; }
+		size_t capacity = std::max(size, 2 * _capacity);
+		std::unique_ptr<T[]> buf(new T[3 * capacity]);
+		std::copy(_x, _x + _size, buf.get());
+		std::copy(_y, _y + _size, buf.get() + capacity);
+		std::copy(_width, _width + _size, buf.get() + 2 * capacity);
+		std::unique_ptr<PqEntry[]> pq(new PqEntry[2 * capacity]);
+		if (!_pq_stale) { std::copy(_pq, _pq + _pq_size, pq.get()); }
+		_capacity = capacity;
+		_heap = std::move(buf);
+		_pq_buf = std::move(pq);
+		bind(_heap.get(), _pq_buf.get());
+	}
+
+	/// 记录一个节点的当前状态；堆满时先丢掉全部旧记录，按当前节点重建
+	void push_pq(T y, T x) {
+		_max_y = std::max(_max_y, y);
+		if (_pq_stale) { return; }
+		if (_pq_size == 2 * _capacity) { rebuild_pq(); }
+		_pq[_pq_size++] = { y, x };
+		std::push_heap(_pq, _pq + _pq_size, PqGreater());
+	}
+
+	void rebuild_pq() {
+		for (size_t i = 0; i < _size; ++i) { _pq[i] = { _y[i], _x[i] }; }
+		_pq_size = _size;
+		_pq_stale = false;
+		std::make_heap(_pq, _pq + _pq_size, PqGreater());
+	}
+
+	/// 有标记时记录[first, last)中的节点将被替换为count个节点
+	void record(size_t first, size_t last, size_t count) {
+		if (_marks.empty()) { return; }
+		_log.push_back({ first, count, _saved.size(), last - first });
+		for (size_t i = first; i < last; ++i) { _saved.push_back({ _x[i], _y[i], _width[i] }); }
+	}
+
+	static uint64_t node_key(T x, T y, T width) { return zobrist_mix(zobrist_mix(zobrist_mix(uint64_t(x)) ^ uint64_t(y)) ^ uint64_t(width)); }
+
+	/// 从哈希中去掉[first, last)中的节点
+	void unhash(size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) { _hash ^= node_key(_x[i], _y[i], _width[i]); }
+	}
+
+	uint64_t full_hash() const {
+		uint64_t res = 0;
+		for (size_t i = 0; i < _size; ++i) { res ^= node_key(_x[i], _y[i], _width[i]); }
+		return res;
+	}
+
+	void drop_marks() {
+		_marks.clear();
+		_log.clear();
+		_saved.clear();
+	}
+
+	/// 把[from, _size)整体移动到to开始的位置
+	void move_tail(size_t from, size_t to) {
+		if (from == to) { return; }
+		if (from > to) {
+			std::copy(_x + from, _x + _size, _x + to);
+			std::copy(_y + from, _y + _size, _y + to);
+			std::copy(_width + from, _width + _size, _width + to);
+		}
+		else {
+			std::copy_backward(_x + from, _x + _size, _x + _size + to - from);
+			std::copy_backward(_y + from, _y + _size, _y + _size + to - from);
+			std::copy_backward(_width + from, _width + _size, _width + _size + to - from);
+		}
+	}
+
+private:
+	T _local[3 * N];
+	PqEntry _local_pq[2 * N];
+	std::unique_ptr<T[]> _heap;
+	std::unique_ptr<PqEntry[]> _pq_buf;
+	T *_x, *_y, *_width;
+	PqEntry *_pq;       // 按(y, x)的小根堆，容量为2 * _capacity
+	size_t _size;
+	size_t _capacity;
+	size_t _pq_size;
+	bool _pq_stale;     // 堆中的记录不全，须按当前节点重建
+	T _max_y;           // 曾入堆的最大y，即当前最高节点的高度
+	uint64_t _hash;     // 各节点Zobrist键的异或
+	std::vector<UndoEntry> _log;
+	std::vector<node_t> _saved;   // 被替换掉的旧节点
+	std::vector<Mark> _marks;
+};
+
+using skyline_t = Skyline<coord_t>;
+
+#endif // SMARTMPW_SKYLINE_HPP
@@ -0,0 +1,113 @@
+//
+// @author   liyan
+// @contact  lyan_dut@outlook.com
+//
+#ifndef SMARTMPW_TRANSPOSITIONTABLE_HPP
+#define SMARTMPW_TRANSPOSITIONTABLE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/// splitmix64，把任意整数打散成64位的Zobrist键
+inline uint64_t zobrist_mix(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/// 有界的置换表：按键的低位直接映射，冲突时覆盖旧项，容量固定为2^capacity_log2
+/// 第一次写入时才申请内存，只查询不写入的求解器(如并行时的工作副本)不占空间
+template<typename V>
+class TranspositionTable {
+public:
+	explicit TranspositionTable(int capacity_log2) :
+		_mask((size_t(1) << capacity_log2) - 1), _probes(0), _hits(0) {}
+
+	bool find(uint64_t key, V &value) {
+		++_probes;
+		if (_entries.empty()) { return false; }
+		const Entry &entry = _entries[key & _mask];
+		if (!entry.used || entry.key != key) { return false; }
+		++_hits;
+		value = entry.value;
+		return true;
+	}
+
+	void insert(uint64_t key, const V &value) {
+		if (_entries.empty()) { _entries.resize(_mask + 1); }
+		Entry &entry = _entries[key & _mask];
+		entry.key = key;
+		entry.value = value;
+		entry.used = true;
+	}
+
+	size_t probes() const { return _probes; }
+	size_t hits() const { return _hits; }
+
+private:
+	struct Entry {
+		uint64_t key;
+		V value;
+		bool used;
+
+		Entry() : key(0), value(), used(false) {}
+	};
+
+	std::vector<Entry> _entries;
+	size_t _mask;
+	size_t _probes;
+	size_t _hits;
+};
+
+/// 分块Bloom过滤器，记录访问过的键：每个键只落在一个512位的块内，在块中置HashNum位，查询只访问一段连续内存
+/// 只增不删，会把少量未访问的键误判为已访问，但不会漏判；容量固定为2^block_num_log2块，第一次查询时才申请内存
+/// 误判率约为置位比例的HashNum次方，置位超过总位数的1/MaxFillInv时整体清空重新记录，误判率保持在0.4%左右
+class VisitedFilter {
+public:
+	static constexpr int HashNum = 4;
+	static constexpr size_t MaxFillInv = 4;
+
+	explicit VisitedFilter(int block_num_log2) :
+		_mask((size_t(1) << block_num_log2) - 1), _set_bits(0), _probes(0), _hits(0), _resets(0) {}
+
+	/// 返回key是否(可能)已访问过，并把key记为已访问
+	bool test_and_set(uint64_t key) {
+		++_probes;
+		if (_words.empty()) { _words.resize((_mask + 1) * BlockWords); }
+		if (_set_bits * MaxFillInv > _words.size() * 64) { clear(); ++_resets; }
+		uint64_t *block = _words.data() + (key & _mask) * BlockWords;
+		uint64_t bits = zobrist_mix(key); // 块内的位与块的下标相互独立
+		bool seen = true;
+		for (int i = 0; i < HashNum; ++i, bits >>= 9) {
+			uint64_t &word = block[(bits & 511) / 64];
+			uint64_t bit = uint64_t(1) << (bits & 63);
+			if (!(word & bit)) { seen = false; word |= bit; ++_set_bits; }
+		}
+		if (seen) { ++_hits; }
+		return seen;
+	}
+
+	/// 忘记全部访问过的键，统计次数保留
+	void clear() {
+		std::fill(_words.begin(), _words.end(), 0);
+		_set_bits = 0;
+	}
+
+	size_t probes() const { return _probes; }
+	size_t hits() const { return _hits; }
+	size_t resets() const { return _resets; }
+
+private:
+	static constexpr size_t BlockWords = 8;
+
+	std::vector<uint64_t> _words;
+	size_t _mask;
+	size_t _set_bits; // 已置位的位数
+	size_t _probes;
+	size_t _hits;
+	size_t _resets;
+};
+
+#endif // SMARTMPW_TRANSPOSITIONTABLE_HPP
@@ -11,6 +11,16 @@
 #include <ctime>
 #include <iomanip>
 #include <random>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
 
 namespace utils {
 
@@ -18,7 +28,7 @@ namespace utils {
 
 	class Date {
 	public:
-		// رʾڸʽַ
+		// 返回表示日期格式的字符串，年月日
 		static string to_short_str() {
 			time_t now = time(nullptr);
 			char mbstr[100];
@@ -29,7 +39,7 @@ namespace utils {
 			//os << put_time(localtime(&now), "%y%m%d");
 			//return os.str();
 		}
-		// رʾڸʽַʱ
+		// 返回表示日期格式的字符串，年月日时分秒
 		static string to_long_str() {
 			time_t now = time(nullptr);
 			char mbstr[100];
@@ -51,6 +61,100 @@ namespace utils {
 		file = str.substr(found1 + 1, found3 - found1 - 1);
 		id = found2 == string::npos ? string() : str.substr(found2, found3 - found2);
 	}
+
+	/// 固定线程数的线程池
+	class ThreadPool {
+	public:
+		explicit ThreadPool(int worker_num = 0) {
+			if (worker_num <= 0) { worker_num = max(1, static_cast<int>(thread::hardware_concurrency())); }
+			_workers.reserve(worker_num);
+			for (int i = 0; i < worker_num; ++i) { _workers.emplace_back([this]() { work(); }); }
+		}
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		~ThreadPool() {
+			{
+				lock_guard<mutex> lock(_mutex);
+				_stop = true;
+			}
+			_cv.notify_all();
+			for (auto &worker : _workers) { worker.join(); }
+		}
+
+		int size() const { return static_cast<int>(_workers.size()); }
+
+		/// 提交一个任务，通过返回的future获取结果
+		template<typename Func>
+		auto submit(Func func) -> future<decltype(func())> {
+			auto task = make_shared<packaged_task<decltype(func())()>>(move(func));
+			future<decltype(func())> res = task->get_future();
+			{
+				lock_guard<mutex> lock(_mutex);
+				_tasks.emplace([task]() { (*task)(); });
+			}
+			_cv.notify_one();
+			return res;
+		}
+
+		/// 并行执行func(i, slot)，i取遍[0, n)
+		/// slot为参与线程的编号，调用线程为0，其余取[1, size()]，可用于索引线程私有的数据；
+		/// 调用线程自身也领取下标，因此在池内任务中嵌套调用不会死锁
+		template<typename Func>
+		void parallel_for(size_t n, Func func) {
+			if (n == 0) { return; }
+			struct ForState {
+				atomic<size_t> next{ 0 };
+				size_t done = 0;
+				mutex done_mutex;
+				condition_variable done_cv;
+			};
+			auto state = make_shared<ForState>();
+			auto loop = [state, n, &func](int slot) {
+				size_t finished = 0;
+				for (size_t i = state->next++; i < n; i = state->next++) {
+					func(i, slot);
+					++finished;
+				}
+				if (finished == 0) { return; }
+				lock_guard<mutex> lock(state->done_mutex);
+				state->done += finished;
+				if (state->done == n) { state->done_cv.notify_all(); }
+			};
+			int helper_num = static_cast<int>(min(n - 1, _workers.size()));
+			for (int slot = 1; slot <= helper_num; ++slot) {
+				lock_guard<mutex> lock(_mutex);
+				_tasks.emplace([loop, slot]() { loop(slot); });
+			}
+			if (helper_num > 0) { _cv.notify_all(); }
+			loop(0);
+			unique_lock<mutex> lock(state->done_mutex);
+			state->done_cv.wait(lock, [&]() { return state->done == n; });
+		}
+
+	private:
+		void work() {
+			while (true) {
+				function<void()> task;
+				{
+					unique_lock<mutex> lock(_mutex);
+					_cv.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+					if (_stop && _tasks.empty()) { return; }
+					task = move(_tasks.front());
+					_tasks.pop();
+				}
+				task();
+			}
+		}
+
+	private:
+		vector<thread> _workers;
+		queue<function<void()>> _tasks;
+		mutex _mutex;
+		condition_variable _cv;
+		bool _stop = false;
+	};
 }
 
 namespace utils_visualize_drawer {